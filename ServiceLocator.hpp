@@ -5,9 +5,32 @@
 #include <map>
 #include <list>
 #include <set>
+#include <unordered_set>
+#include <vector>
+#include <memory>
+#include <new>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <future>
+#include <system_error>
+#include <exception>
+#include <cstdint>
+#include <cstdlib>
+#include <chrono>
 #include <typeindex>
+#include <tuple>
+#include <algorithm>
 #include <cxxabi.h>
 
+// Define SERVICELOCATOR_STATS before including to record per binding resolve statistics, see
+// ServiceLocator::getBindingStats().  Without it no statistics code is compiled in
+#ifdef SERVICELOCATOR_STATS
+#include <ostream>
+#endif
+
 #ifndef SERVICELOCATOR_SPTR
 #define SERVICELOCATOR_SPTR
 template <class T>
@@ -67,29 +90,138 @@ public:
 
 class ServiceLocator {
 public:
+    class Context;
     friend class Context;
     
+    template <class IFace>
+    class Lazy;
+    
+    template <class IFace>
+    class ResolveResult;
+    
+    // Why a ResolveResult has no value
+    enum class ResolveError { None, Unbound, Recursive, Failed };
+    
+private:
+    template <class IFace>
+    class TypedServiceLocator;
+    
+public:
+    
+    // A binding name interned in the process wide name table (see ServiceLocator::name()).  Interned names
+    // are unique so they compare by pointer, and their hash is computed once, resolving by an interned Name
+    // does no hashing or string comparisons
+    class Name {
+        friend class ServiceLocator;
+        friend class Context;
+        
+    private:
+        const std::string* _name;
+        size_t _hash;
+        bool _interned;
+        
+        Name(const std::string* name, size_t hash, bool interned) :
+            _name(name),
+            _hash(hash),
+            _interned(interned) {
+        }
+        
+        // Refers to a name which has not been interned, used to resolve by std::string
+        explicit Name(const std::string& name) : Name(&name, std::hash<std::string>()(name), false) {
+        }
+        
+    public:
+        const std::string& str() const {
+            return *_name;
+        }
+        
+        bool operator==(const Name& rhs) const {
+            if (_interned && rhs._interned) {
+                return _name == rhs._name;
+            }
+            return _hash == rhs._hash && *_name == *rhs._name;
+        }
+    };
+    
+    // Intern a binding name, resolving with the returned Name is cheaper than resolving with a std::string
+    static Name name(const std::string& name) {
+        // Deliberately never destroyed, Names may be referenced up until the process exits
+        static std::mutex* mutex = new std::mutex();
+        static std::unordered_set<std::string>* names = new std::unordered_set<std::string>();
+        
+        std::lock_guard<std::mutex> lock(*mutex);
+        auto interned = names->insert(name).first;
+        return Name(&*interned, std::hash<std::string>()(name), true);
+    }
+    
     class Context {
+        friend class ServiceLocator;
+        
     private:
         Context& operator=(const Context&) = delete; // non copyable
         Context(const Context&) = delete;            // non construction-copyable
 
         // Only the root Context will run the AfterResolveList - this allows circular dependancies to
-        // resolve by using afterResolve property injection
+        // resolve by using afterResolve property injection.  The untyped Contexts handed out by getContext()
+        // are shared between threads, they have no _root so every resolve made from them is its own root
         Context* _root;
         std::list<std::function<void(sptr<Context>)>>* _fnAfterResolveList = nullptr;
         
+        // Bloom filter of the (interface, name) pairs being resolved below the root, only used (and only
+        // initialised) in the root.  A resolve whose bit is clear cannot be recursive so only a set bit needs
+        // the Context chain walked.  Frames end in reverse order of starting, so the frame which set a bit
+        // clears it as it ends.  512 bits keep a 40 frame deep chain of named bindings to a few percent of
+        // frames walking the chain
+        static const size_t InProgressWords = 8;
+        uint64_t _inProgress[InProgressWords];
+        uint64_t _inProgressBit = 0;
+        size_t _inProgressWord = 0;
+        
+        // Resolve Contexts are stack frames which live only for the duration of their resolve, so they
+        // refer to (rather than copy) their ServiceLocator and name
         Context* _parent;
-        wptr<ServiceLocator> _sl;
+        ServiceLocator* _sl;
         std::type_index _interfaceType;
-        mutable uptr<std::string> _interfaceTypeName;
-        std::string _name;
+        Name _name;
         
-        uptr<std::type_index> _concreteType;
-        mutable uptr<std::string> _concreteTypeName;
+        bool _hasConcreteType;
+        std::type_index _concreteType;
         
+        // Set whilst a transient binding creates its instance, only transients are placed in an arena
+        bool _transient;
         
-        std::string getTypeName(const std::type_index& typeIndex) const {
+        // Set on a frame constructing an instance its binding keeps (singleton, thread local or scoped) and
+        // inherited by the frames below it.  A transient created below it may be kept for as long as that
+        // instance (eg a parent singleton first resolved from an arena child), so is not placed in an arena
+        bool _cached;
+        
+        
+        static const Name& noName() {
+            static const Name name = ServiceLocator::name("");
+            return name;
+        }
+        
+        // Wrap a stack Context in a non-owning shared_ptr (no control block is allocated) for handing to
+        // binding functions which take an SLContext_sptr
+        static sptr<Context> borrow(Context& ctx) {
+            return sptr<Context>(sptr<Context>(), &ctx);
+        }
+        
+        // Demangled once per type, the returned name lives until the process exits
+        static const std::string& getTypeName(const std::type_index& typeIndex) {
+            // Deliberately never destroyed, like the interned Names
+            static std::mutex* mutex = new std::mutex();
+            static std::map<std::type_index, std::string>* names = new std::map<std::type_index, std::string>();
+            
+            std::lock_guard<std::mutex> lock(*mutex);
+            auto found = names->find(typeIndex);
+            if (found != names->end()) {
+                return found->second;
+            }
+            return names->insert(std::make_pair(typeIndex, demangle(typeIndex))).first->second;
+        }
+        
+        static std::string demangle(const std::type_index& typeIndex) {
             int status;
             auto s = __cxxabiv1::__cxa_demangle (typeIndex.name(), nullptr, nullptr, &status);
             std::string result;
@@ -107,27 +239,69 @@ public:
                     result = "Invalid arguments";
                     break;
             }
-            if (s) {
-                delete s;
-            }
+            // __cxa_demangle allocates with malloc
+            std::free(s);
             return result;
         }
         
-        void checkRecursiveResolve(Context* resolveCtx, Context* compareCtx) {
-            if (resolveCtx->_interfaceType == compareCtx->_interfaceType && resolveCtx->_name == compareCtx->_name) {
-                throw RecursiveResolveException("Recursive resolve path = " + resolveCtx->getResolvePath());
+        // Called on a new resolve frame, throws if this interface and name are already being resolved
+        template <class IFace>
+        void checkRecursiveResolve() {
+            auto key = ServiceLocator::typeSlot<IFace>() * 31 + _name._hash;
+            auto word = (key >> 6) & (InProgressWords - 1);
+            uint64_t bit = uint64_t(1) << (key & 63);
+            if ((_root->_inProgress[word] & bit) == 0) {
+                _root->_inProgress[word] |= bit;
+                _inProgressBit = bit;
+                _inProgressWord = word;
+                return;
             }
-            if (compareCtx->_parent != nullptr) {
-                checkRecursiveResolve(resolveCtx, compareCtx->_parent);
+            for(auto ctx = _parent; ctx != nullptr; ctx = ctx->_parent) {
+                if (_interfaceType == ctx->_interfaceType && _name == ctx->_name) {
+                    throw RecursiveResolveException("Recursive resolve path = " + getResolvePath());
+                }
             }
         }
 
+        template <class IFace>
+        void resolveBindings(const std::vector<typename TypedServiceLocator<IFace>::shared_ptr_binding*>& bindings, std::vector<sptr<IFace>>& all) {
+            all.reserve(all.size() + bindings.size());
+            // one frame for every element, so after resolve functions run once all of them are resolved
+            Context ctx(this, std::type_index(typeid(IFace)), noName());
+            for(auto binding : bindings) {
+                ctx.nextElement<IFace>();
+                all.push_back(binding->get(ctx));
+            }
+            ctx.afterResolve();
+        }
+        
+        // Make this frame the resolve of another element, resolveMany() and resolveAll() resolve each element
+        // in one frame
+        template <class IFace>
+        void nextElement() {
+            if (_inProgressBit != 0) {
+                _root->_inProgress[_inProgressWord] &= ~_inProgressBit;
+                _inProgressBit = 0;
+            }
+            _interfaceType = std::type_index(typeid(IFace));
+            _hasConcreteType = false;
+            _transient = false;
+            _cached = _parent != nullptr && _parent->_cached;
+            checkRecursiveResolve<IFace>();
+        }
+        
+        template <class IFace>
+        sptr<IFace> resolveElement() {
+            nextElement<IFace>();
+            return _sl->_resolve<IFace>(*this);
+        }
+        
         void afterResolve() {
             if (this == _root) {
                 if (_fnAfterResolveList != nullptr) {
                     for(auto fn : *_fnAfterResolveList) {
-                        auto ctx = sptr<Context>(new Context(_sl));
-                        fn(ctx);
+                        Context ctx(_sl);
+                        fn(borrow(ctx));
                     }
                     delete _fnAfterResolveList;
                     _fnAfterResolveList = nullptr;
@@ -136,39 +310,46 @@ public:
         }
         
     public:
-        Context(Context* root, Context* parent, wptr<ServiceLocator> sl, const std::type_index interfaceType, const std::string& name) :
+        Context(Context* root, Context* parent, ServiceLocator* sl, const std::type_index interfaceType, const Name& name) :
             _root(root),
             _parent(parent),
             _sl(sl),
             _interfaceType(interfaceType),
-            _interfaceTypeName(),
             _name(name),
-            _concreteType(),
-            _concreteTypeName()
+            _hasConcreteType(false),
+            _concreteType(typeid(void)),
+            _transient(false),
+            _cached(parent != nullptr && parent->_cached)
         {
-
+            if (root == this) {
+                std::fill(_inProgress, _inProgress + InProgressWords, uint64_t(0));
+            }
         }
 
-        Context(Context* parent, const std::type_index interfaceType, const std::string& name) :
-            Context(parent->_root, parent, parent->_sl, interfaceType, name) {
+        Context(Context* parent, const std::type_index interfaceType, const Name& name) :
+            Context(parent->_root != nullptr ? parent->_root : this, parent, parent->_sl, interfaceType, name) {
         }
 
-        Context(wptr<ServiceLocator> sl, const std::type_index interfaceType, const std::string& name) :
+        Context(ServiceLocator* sl, const std::type_index interfaceType, const Name& name) :
             Context(this, nullptr, sl, interfaceType, name) {
         }
 
-        Context(wptr<ServiceLocator> sl) : Context(this, nullptr, sl, std::type_index(typeid(void)), "") {
+        Context(ServiceLocator* sl) : Context(nullptr, nullptr, sl, std::type_index(typeid(void)), noName()) {
+        }
+        
+        ~Context() {
+            if (_inProgressBit != 0) {
+                _root->_inProgress[_inProgressWord] &= ~_inProgressBit;
+            }
+            delete _fnAfterResolveList;
         }
         
         const std::string& getName() const {
-            return _name;
+            return _name.str();
         }
         
         const std::string& getInterfaceTypeName() const {
-            if (_interfaceTypeName == nullptr) {
-                _interfaceTypeName = uptr<std::string>(new std::string(getTypeName(_interfaceType)));
-            }
-            return *_interfaceTypeName;
+            return getTypeName(_interfaceType);
         }
         
         const std::type_index& getInterfaceTypeIndex() const {
@@ -176,21 +357,19 @@ public:
         }
         
         void setConcreteType(const std::type_index& concreteType) {
-            if (_concreteType != nullptr) {
+            if (_hasConcreteType) {
                 throw BindingIssueException("Concrete type on Context already set");
             }
-            _concreteType = uptr<std::type_index>(new std::type_index(concreteType));
+            _concreteType = concreteType;
+            _hasConcreteType = true;
         }
         
         const std::string& getConcreteTypeName() const {
-            if (_concreteTypeName == nullptr) {
-                _concreteTypeName = uptr<std::string>(new std::string(getTypeName(*_concreteType)));
-            }
-            return *_concreteTypeName;
+            return getTypeName(_concreteType);
         }
         
         const std::type_index& getConcreteTypeIndex() const {
-            return *_concreteType;
+            return _concreteType;
         }
 
         Context* getParent() const {
@@ -198,124 +377,337 @@ public:
         }
         
         sptr<ServiceLocator> getServiceLocator() const {
-            return _sl.lock();
+            return _sl->_this.lock();
+        }
+        
+        // Create a new TImpl(args...) with its shared_ptr control block in the same allocation, for a transient
+        // resolved from a ServiceLocator created by enterArena() (on the thread which created it) that
+        // allocation is made in the arena
+        template <class TImpl, class... TArgs>
+        sptr<TImpl> make(TArgs&&... args) {
+            if (_transient && !_cached && _sl->_arena != nullptr && _sl->_arena->owned()) {
+                return std::allocate_shared<TImpl>(arena_allocator<TImpl>(_sl->_arena), std::forward<TArgs>(args)...);
+            }
+            return std::make_shared<TImpl>(std::forward<TArgs>(args)...);
         }
         
         // Resolve a named interface, throws if not able to resolve
         template <class IFace>
         sptr<IFace> resolve(const std::string& named) {
-            auto ctx = sptr<Context>(new Context(this, std::type_index(typeid(IFace)), named));
-            checkRecursiveResolve(ctx.get(), this);
-            auto ptr = _sl.lock()->_resolve<IFace>(ctx);
-            afterResolve();
+            return resolve<IFace>(Name(named));
+        }
+
+        // Resolve an interface by interned name, throws if not able to resolve
+        template <class IFace>
+        sptr<IFace> resolve(const Name& named) {
+            Context ctx(this, std::type_index(typeid(IFace)), named);
+            ctx.checkRecursiveResolve<IFace>();
+            auto ptr = _sl->_resolve<IFace>(ctx);
+            ctx.afterResolve();
             return ptr;
         }
 
         // Resolve an interface, throws if not able to resolve
         template <class IFace>
         sptr<IFace> resolve() {
-            auto ctx = sptr<Context>(new Context(this, std::type_index(typeid(IFace)), ""));
-            checkRecursiveResolve(ctx.get(), this);
-            auto ptr = _sl.lock()->_resolve<IFace>(ctx);
-            afterResolve();
-            return ptr;
+            return resolve<IFace>(noName());
         }
 
+        // Resolve several interfaces at once, eg
+        //   std::tie(foo, bar) = slc->resolveMany<IFoo, IBar>();
+        // they are resolved in order (in one Context frame), throws if any is not able to resolve
+        template <class... IFaces>
+        std::tuple<sptr<IFaces>...> resolveMany() {
+            Context ctx(this, std::type_index(typeid(void)), noName());
+            // braced initialisation guarantees the elements are resolved left to right
+            std::tuple<sptr<IFaces>...> resolved{ctx.resolveElement<IFaces>()...};
+            ctx.afterResolve();
+            return resolved;
+        }
+        
+        // Resolve every binding of an interface (in this ServiceLocator and its parents), adding them to all
         template <class IFace>
         void resolveAll(std::vector<sptr<IFace>>* all) {
-            _sl.lock()->_visitAll<IFace>([this, all] (sptr<typename TypedServiceLocator<IFace>::shared_ptr_binding> binding) {
-                auto ctx = sptr<Context>(new Context(this, std::type_index(typeid(IFace)), ""));
-                checkRecursiveResolve(ctx.get(), this);
-                all->push_back(binding->get(ctx));
-            });
-            afterResolve();
+            if (_sl->_flattened != nullptr) {
+                auto& view = _sl->resolveAllView<IFace>();
+                auto instances = view.instances.load(std::memory_order_acquire);
+                if (instances != nullptr) {
+                    all->insert(all->end(), instances->begin(), instances->end());
+                } else {
+                    resolveBindings<IFace>(view.bindings, *all);
+                }
+                return;
+            }
+            
+            std::vector<typename TypedServiceLocator<IFace>::shared_ptr_binding*> bindings;
+            _sl->collectBindings<IFace>(bindings);
+            resolveBindings<IFace>(bindings, *all);
+        }
+        
+        // Resolve every binding of an interface (in this ServiceLocator and its parents).  Once the ServiceLocator
+        // is sealed and every binding is a constructed singleton or instance the same (immutable) vector is
+        // returned by every call, without resolving anything
+        template <class IFace>
+        sptr<const std::vector<sptr<IFace>>> resolveAll() {
+            if (_sl->_flattened == nullptr) {
+                auto all = std::make_shared<std::vector<sptr<IFace>>>();
+                resolveAll<IFace>(all.get());
+                return all;
+            }
+            
+            auto& view = _sl->resolveAllView<IFace>();
+            auto instances = view.instances.load(std::memory_order_acquire);
+            if (instances == nullptr) {
+                auto all = uptr<std::vector<sptr<IFace>>>(new std::vector<sptr<IFace>>());
+                resolveBindings<IFace>(view.bindings, *all);
+                if (!view.constructed()) {
+                    return sptr<const std::vector<sptr<IFace>>>(std::move(all));
+                }
+                if (view.instances.compare_exchange_strong(instances, all.get(), std::memory_order_acq_rel)) {
+                    instances = all.release();
+                }
+            }
+            // the view is owned by the ServiceLocator, the returned vector keeps it alive
+            return sptr<const std::vector<sptr<IFace>>>(_sl->_this.lock(), instances);
         }
         
         // Determine if a named interface can be resolved
         template <class IFace>
         bool canResolve(const std::string& named) {
-            auto ctx = sptr<Context>(new Context(this, std::type_index(typeid(IFace)), named));
-            return _sl.lock()->_canResolve<IFace>(ctx);
+            return canResolve<IFace>(Name(named));
+        }
+
+        // Determine if an interface can be resolved by interned name
+        template <class IFace>
+        bool canResolve(const Name& named) {
+            return _sl->_canResolve<IFace>(named);
         }
 
         // Determine if an interface can be resolved
         template <class IFace>
         bool canResolve() {
-            auto ctx = sptr<Context>(new Context(this, std::type_index(typeid(IFace)), ""));
-            return _sl.lock()->_canResolve<IFace>(ctx);
+            return canResolve<IFace>(noName());
         }
 
         // Try to resolve a named interface, returns nullptr on failure
         template <class IFace>
         sptr<IFace> tryResolve(const std::string& named) {
-            auto ctx = sptr<Context>(new Context(this, std::type_index(typeid(IFace)), named));
-            checkRecursiveResolve(ctx.get(), this);
-            auto ptr = _sl.lock()->_tryResolve<IFace>(ctx);
-            afterResolve();
+            return tryResolve<IFace>(Name(named));
+        }
+
+        // Try to resolve an interface by interned name, returns nullptr on failure
+        template <class IFace>
+        sptr<IFace> tryResolve(const Name& named) {
+            Context ctx(this, std::type_index(typeid(IFace)), named);
+            ctx.checkRecursiveResolve<IFace>();
+            auto ptr = _sl->_tryResolve<IFace>(ctx);
+            ctx.afterResolve();
             return ptr;
         }
 
         // Try to resolve an interface, returns nullptr on failure
         template <class IFace>
         sptr<IFace> tryResolve() {
-            auto ctx = sptr<Context>(new Context(this, std::type_index(typeid(IFace)), ""));
-            checkRecursiveResolve(ctx.get(), this);
-            auto ptr = _sl.lock()->_tryResolve<IFace>(ctx);
-            afterResolve();
-            return ptr;
+            return tryResolve<IFace>(noName());
+        }
+        
+        // Resolve a named interface without throwing, the name is only looked up (not interned), a failed result
+        // copies it into its message
+        template <class IFace>
+        ResolveResult<IFace> resolveResult(const std::string& named) {
+            auto result = resolveResult<IFace>(Name(named));
+            if (!result) {
+                result.detach();
+            }
+            return result;
+        }
+        
+        // Resolve an interface by interned name without throwing.  An unbound interface is only looked up, it
+        // neither throws nor allocates, its diagnostic is rendered by getMessage().  Exceptions thrown whilst
+        // resolving a bound interface (eg its dependencies are unbound or recursive) are caught into the result
+        template <class IFace>
+        ResolveResult<IFace> resolveResult(const Name& named) {
+            auto binding = _sl->_findBinding<IFace>(named);
+            if (binding == nullptr) {
+                return ResolveResult<IFace>(ResolveError::Unbound, named);
+            }
+            
+            Context ctx(this, std::type_index(typeid(IFace)), named);
+            try {
+                ctx.checkRecursiveResolve<IFace>();
+                auto ptr = binding->get(ctx);
+                ctx.afterResolve();
+                return ResolveResult<IFace>(ptr);
+            } catch (const RecursiveResolveException& e) {
+                return ResolveResult<IFace>(ResolveError::Recursive, named, e.getMessage());
+            } catch (const ServiceLocatorException& e) {
+                return ResolveResult<IFace>(ResolveError::Failed, named, e.getMessage());
+            }
+        }
+        
+        // Resolve an interface without throwing
+        template <class IFace>
+        ResolveResult<IFace> resolveResult() {
+            return resolveResult<IFace>(noName());
         }
         
         template <class IFace>
         std::function<sptr<IFace>(const std::string&)> provider() {
             // We lock the weak_ptr to our ServiceLocator, the lock returns a shared_ptr which will keep
             // it alive into the returned lambda via the capture of sl
-            auto sl = _sl.lock();
+            auto sl = getServiceLocator();
             return [sl] (const std::string& name) {
-                auto ctx = sptr<Context>(new Context(sl, std::type_index(typeid(IFace)), name));
-                // Don't need to check for recursive resolve since this is a provider (root) call
+                Context ctx(sl.get(), std::type_index(typeid(IFace)), Name(name));
+                // A provider call is a root so cannot be recursive, this marks it in progress for its children
+                ctx.checkRecursiveResolve<IFace>();
                 auto ptr = sl->_resolve<IFace>(ctx);
                 // ctx is root Context, it can afterResolve
-                ctx->afterResolve();
+                ctx.afterResolve();
+                return ptr;
+            };
+        }
+        
+        // A Lazy resolving a named interface on first use
+        template <class IFace>
+        Lazy<IFace> lazy(const std::string& named) {
+            return Lazy<IFace>(*_sl, ServiceLocator::name(named));
+        }
+        
+        // A Lazy resolving an interface on first use
+        template <class IFace>
+        Lazy<IFace> lazy() {
+            return Lazy<IFace>(*_sl, noName());
+        }
+        
+        // Resolve a named interface on another thread, eg to construct independent dependencies concurrently
+        //   auto food = slc->resolveAsync<IFood>("Banana");
+        //   auto drink = slc->resolveAsync<IDrink>();
+        //   return new Monkey(food.get(), drink.get());
+        // a failure to resolve is thrown by get()
+        template <class IFace>
+        std::future<sptr<IFace>> resolveAsync(const std::string& named) {
+            return resolveAsync<IFace>(ServiceLocator::name(named));
+        }
+        
+        // Resolve an interface by interned name on another thread.  An already constructed singleton or instance
+        // is returned in a ready future without starting a thread, as is any resolve once AsyncThreadLimit threads
+        // are already resolving or no thread can be started (it is resolved on this thread).  The resolve is its own root, but one which waits
+        // on a singleton the calling thread is constructing throws RecursiveResolveException from get()
+        template <class IFace>
+        std::future<sptr<IFace>> resolveAsync(const Name& named) {
+            auto binding = _sl->findBinding<IFace>(named);
+            if (binding != nullptr && binding->constructed()) {
+                std::promise<sptr<IFace>> resolved;
+                try {
+                    resolved.set_value(resolve<IFace>(named));
+                } catch (...) {
+                    resolved.set_exception(std::current_exception());
+                }
+                return resolved.get_future();
+            }
+            
+            // the name has to outlive this call, only interned names do
+            auto name = named._interned ? named : ServiceLocator::name(named.str());
+            auto sl = getServiceLocator();
+            auto fnResolve = [sl, name] () {
+                Context ctx(sl.get(), std::type_index(typeid(IFace)), name);
+                ctx.checkRecursiveResolve<IFace>();
+                auto ptr = sl->_resolve<IFace>(ctx);
+                ctx.afterResolve();
                 return ptr;
             };
+            if (asyncThreads().fetch_add(1, std::memory_order_relaxed) < AsyncThreadLimit) {
+                auto awaiting = awaitingSlots();
+                auto& constructing = constructingSlots();
+                awaiting.insert(awaiting.end(), constructing.begin(), constructing.end());
+                try {
+                    return std::async(std::launch::async, [fnResolve, awaiting] () {
+                        struct async_thread {
+                            ~async_thread() {
+                                asyncThreads().fetch_sub(1, std::memory_order_relaxed);
+                            }
+                        } thread;
+                        awaitingSlots() = awaiting;
+                        return fnResolve();
+                    });
+                } catch (const std::system_error&) {
+                    // no thread could be started, resolve on this one instead
+                }
+            }
+            asyncThreads().fetch_sub(1, std::memory_order_relaxed);
+            std::promise<sptr<IFace>> resolved;
+            try {
+                resolved.set_value(fnResolve());
+            } catch (...) {
+                resolved.set_exception(std::current_exception());
+            }
+            return resolved.get_future();
+        }
+        
+        // Resolve an interface on another thread
+        template <class IFace>
+        std::future<sptr<IFace>> resolveAsync() {
+            return resolveAsync<IFace>(noName());
         }
         
         template <class IFace>
         std::function<sptr<IFace>(const std::string&)> tryProvider() {
             // We lock the weak_ptr to our ServiceLocator, the lock returns a shared_ptr which will keep
             // it alive into the returned lambda via the capture of sl
-            auto sl = _sl.lock();
+            auto sl = getServiceLocator();
             return [sl] (const std::string& name) {
-                auto ctx = sptr<Context>(new Context(sl, std::type_index(typeid(IFace)), name));
-                // Don't need to check for recursive resolve since this is a tryProvider (root) call
+                Context ctx(sl.get(), std::type_index(typeid(IFace)), Name(name));
+                // A tryProvider call is a root so cannot be recursive, this marks it in progress for its children
+                ctx.checkRecursiveResolve<IFace>();
                 auto ptr = sl->_tryResolve<IFace>(ctx);
                 // ctx is root Context, it can afterResolve
-                ctx->afterResolve();
+                ctx.afterResolve();
                 return ptr;
             };
         }
         
         std::string getResolvePath() const {
-            std::string path = "";
             // Note the root Parent has a <ServiceLocator> IFace which is not real, just cannot have no interface defined
-            if (_parent != nullptr && _parent->_parent != nullptr) {
-                path = _parent->getResolvePath() + " -> ";
+            std::vector<const Context*> frames;
+            size_t length = 0;
+            for(auto ctx = this; ctx != nullptr; ctx = ctx->_parent) {
+                frames.push_back(ctx);
+                length += ctx->getInterfaceTypeName().size() + ctx->_name.str().size() + 16;
+                if (ctx->_hasConcreteType) {
+                    length += ctx->getConcreteTypeName().size() + 5;
+                }
+                if (ctx->_parent == nullptr || ctx->_parent->_parent == nullptr) {
+                    break;
+                }
             }
             
-            path += "resolve<" + getInterfaceTypeName() + ">(" + _name + ")";
-
-            if (_concreteType != nullptr) {
-                path += ".to<" + getConcreteTypeName() + ">";
+            // Rendered root first into one buffer
+            std::string path;
+            path.reserve(length);
+            for(auto frame = frames.rbegin(); frame != frames.rend(); frame++) {
+                if (frame != frames.rbegin()) {
+                    path += " -> ";
+                }
+                path += "resolve<";
+                path += (*frame)->getInterfaceTypeName();
+                path += ">(";
+                path += (*frame)->_name.str();
+                path += ")";
+                if ((*frame)->_hasConcreteType) {
+                    path += ".to<";
+                    path += (*frame)->getConcreteTypeName();
+                    path += ">";
+                }
             }
-            
             return path;
         }
         
         void afterResolve(std::function<void(sptr<Context>)> fnAfterResolve) {
-            if (_root->_fnAfterResolveList == nullptr) {
-                _root->_fnAfterResolveList = new std::list<std::function<void(sptr<Context>)>>();
+            auto root = _root != nullptr ? _root : this;
+            if (root->_fnAfterResolveList == nullptr) {
+                root->_fnAfterResolveList = new std::list<std::function<void(sptr<Context>)>>();
             }
-            _root->_fnAfterResolveList->push_back(fnAfterResolve);
+            root->_fnAfterResolveList->push_back(fnAfterResolve);
         }
     };
     
@@ -323,48 +715,942 @@ private:
     ServiceLocator& operator=(const ServiceLocator&) = delete; // non copyable
     ServiceLocator(const ServiceLocator&) = delete;            // non construction-copyable
 
-    class AnyServiceLocator {
+    // Construction of singletons happens outside of any lock, the mutex + condition only guard the
+    // slow path hand-off between the constructing thread and any threads waiting on it
+    static std::mutex& constructionMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    static std::condition_variable& constructionDone() {
+        static std::condition_variable done;
+        return done;
+    }
+    
+    // For each thread waiting on another thread's construction, the constructing thread of the slot it waits
+    // on.  Guarded by constructionMutex(), lets a waiting thread see that it would wait on itself
+    static std::map<std::thread::id, const std::thread::id*>& constructionWaits() {
+        static std::map<std::thread::id, const std::thread::id*> waits;
+        return waits;
+    }
+    
+    // The slots (their constructing thread) this thread is constructing, innermost last
+    static std::vector<const std::thread::id*>& constructingSlots() {
+        static thread_local std::vector<const std::thread::id*> slots;
+        return slots;
+    }
+    
+    // On a resolveAsync() thread, the slots the thread(s) which asked for it were constructing.  They may be
+    // waiting on its future so it must not wait on them, it throws as a recursive resolve instead
+    static std::vector<const std::thread::id*>& awaitingSlots() {
+        static thread_local std::vector<const std::thread::id*> slots;
+        return slots;
+    }
+    
+    // resolveAsync() threads running, past AsyncThreadLimit it resolves on the calling thread instead
+    static const size_t AsyncThreadLimit = 64;
+    
+    static std::atomic<size_t>& asyncThreads() {
+        static std::atomic<size_t> threads(0);
+        return threads;
+    }
+
+    // Lazily constructed instance, exactly one thread constructs the instance whilst any other threads
+    // resolving it wait.  Once constructed, reads are a single acquire load
+    template <class T>
+    class instance_slot {
+    private:
+        enum State { Empty, Constructing, Constructed };
+
+        std::atomic<int> _state;
+        std::thread::id _constructingThread;
+        sptr<T> _instance;
+
     public:
-        virtual ~AnyServiceLocator() {
+        instance_slot() : _state(Empty), _constructingThread(), _instance() {
+        }
+
+        template <class FnCreate>
+        sptr<T> get(Context& slc, const FnCreate& fnCreate) {
+            if (constructed()) {
+                return _instance;
+            }
+            return construct(slc, fnCreate);
         }
         
-        class loose_binding {
-        public:
-            virtual ~loose_binding() {
+        bool constructed() const {
+            return _state.load(std::memory_order_acquire) == Constructed;
+        }
+        
+        // Only valid once constructed() is true
+        const sptr<T>& value() const {
+            return _instance;
+        }
+        
+        // Set the instance up front, only whilst binding (nothing can be resolving it)
+        void set(const sptr<T>& instance) {
+            _instance = instance;
+            _state.store(Constructed, std::memory_order_release);
+        }
+
+    private:
+        template <class FnCreate>
+        sptr<T> construct(Context& slc, const FnCreate& fnCreate) {
+            std::unique_lock<std::mutex> lock(constructionMutex());
+            auto thisThread = std::this_thread::get_id();
+            while (_state.load(std::memory_order_acquire) == Constructing) {
+                // Singletons which depend on each other being constructed on different threads would wait on
+                // each other forever, follow what the constructing thread is itself waiting on
+                auto& waits = constructionWaits();
+                auto& awaiting = awaitingSlots();
+                for(const std::thread::id* slot = &_constructingThread; *slot != std::thread::id(); ) {
+                    if (*slot == thisThread || std::find(awaiting.begin(), awaiting.end(), slot) != awaiting.end()) {
+                        throw RecursiveResolveException("Recursive resolve path = " + slc.getResolvePath());
+                    }
+                    auto wait = waits.find(*slot);
+                    if (wait == waits.end()) {
+                        break;
+                    }
+                    slot = wait->second;
+                }
+                constructionWaits()[thisThread] = &_constructingThread;
+                constructionDone().wait(lock);
+                constructionWaits().erase(thisThread);
+            }
+            if (_state.load(std::memory_order_acquire) == Constructed) {
+                return _instance;
+            }
+
+            _state.store(Constructing, std::memory_order_relaxed);
+            _constructingThread = std::this_thread::get_id();
+            lock.unlock();
+
+            auto& constructing = constructingSlots();
+            constructing.push_back(&_constructingThread);
+            sptr<T> instance;
+            try {
+                instance = fnCreate();
+            } catch (...) {
+                constructing.pop_back();
+                lock.lock();
+                _constructingThread = std::thread::id();
+                _state.store(Empty, std::memory_order_release);
+                constructionDone().notify_all();
+                throw;
+            }
+
+            constructing.pop_back();
+            lock.lock();
+            _instance = instance;
+            _constructingThread = std::thread::id();
+            _state.store(Constructed, std::memory_order_release);
+            constructionDone().notify_all();
+            return instance;
+        }
+    };
+
+    // asThreadLocal() and asScoped() bindings are given a slot, an index into the vector of instances each
+    // thread (or child ServiceLocator) keeps.  Slots are reused once their binding is destroyed, so each
+    // instance records the generation of the binding which created it and an instance left over from a
+    // destroyed binding is never mistaken for its own.  A thread's instance is held in a cell the binding also
+    // keeps a weak reference to, so it is destroyed when either the thread exits or the binding is destroyed
+    struct thread_local_cell {
+        sptr<void> instance;
+    };
+    
+    struct thread_local_entry {
+        uint64_t generation;
+        sptr<thread_local_cell> cell;
+    };
+    
+    static std::vector<thread_local_entry>& threadLocalInstances() {
+        static thread_local std::vector<thread_local_entry> instances;
+        return instances;
+    }
+    
+    // Each thread's last seen version of each Reloadable, indexed by the Reloadable's slot.  Publish generations
+    // are unique across all Reloadables so an entry left over from a destroyed one never matches.  Only weak, a
+    // thread which stops resolving does not keep a replaced version alive
+    struct reloadable_entry {
+        uint64_t generation;
+        wptr<ServiceLocator> version;
+    };
+    
+    static std::vector<reloadable_entry>& reloadableVersions() {
+        static thread_local std::vector<reloadable_entry> versions;
+        return versions;
+    }
+    
+    static std::mutex& bindingSlotMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+    
+    static std::vector<size_t>& freeBindingSlots() {
+        static std::vector<size_t> slots;
+        return slots;
+    }
+    
+    static void acquireBindingSlot(size_t& slot, uint64_t& generation) {
+        static size_t nextSlot = 0;
+        static uint64_t nextGeneration = 0;
+        std::lock_guard<std::mutex> lock(bindingSlotMutex());
+        auto& slots = freeBindingSlots();
+        if (slots.empty()) {
+            slot = nextSlot++;
+        } else {
+            slot = slots.back();
+            slots.pop_back();
+        }
+        generation = ++nextGeneration;
+    }
+    
+    static void releaseBindingSlot(size_t slot) {
+        std::lock_guard<std::mutex> lock(bindingSlotMutex());
+        freeBindingSlots().push_back(slot);
+    }
+    
+    struct scoped_entry {
+        uint64_t generation;
+        instance_slot<void> instance;
+    };
+    
+    // Entries indexed by a slot number, finding an entry takes no lock.  The table is replaced (never changed)
+    // as entries are added, replaced tables are kept until the slot_table is cleared or destroyed as another
+    // thread may still be reading one
+    template <class TEntry>
+    class slot_table {
+    private:
+        slot_table& operator=(const slot_table&) = delete; // non copyable
+        slot_table(const slot_table&) = delete;            // non construction-copyable
+        
+        std::mutex _mutex;
+        std::atomic<const std::vector<TEntry*>*> _table;
+        std::vector<uptr<const std::vector<TEntry*>>> _tables;
+        std::vector<uptr<TEntry>> _entries;
+        
+        TEntry* find(size_t slot) const {
+            auto table = _table.load(std::memory_order_acquire);
+            return table != nullptr && slot < table->size() ? (*table)[slot] : nullptr;
+        }
+        
+    public:
+        slot_table() : _mutex(), _table(nullptr), _tables(), _entries() {
+        }
+        
+        // The slot's entry if fnValid accepts it, otherwise a new entry from fnCreate replaces it
+        template <class FnValid, class FnCreate>
+        TEntry& get(size_t slot, const FnValid& fnValid, const FnCreate& fnCreate) {
+            auto entry = find(slot);
+            if (entry != nullptr && fnValid(*entry)) {
+                return *entry;
             }
             
-            virtual void eagerBind(sptr<Context> slc) = 0;
-        };
+            std::lock_guard<std::mutex> lock(_mutex);
+            entry = find(slot);
+            if (entry != nullptr && fnValid(*entry)) {
+                return *entry;
+            }
+            entry = fnCreate();
+            _entries.push_back(uptr<TEntry>(entry));
+            auto current = _table.load(std::memory_order_relaxed);
+            auto table = current != nullptr ? new std::vector<TEntry*>(*current) : new std::vector<TEntry*>();
+            if (slot >= table->size()) {
+                table->resize(slot + 1);
+            }
+            (*table)[slot] = entry;
+            _tables.push_back(uptr<const std::vector<TEntry*>>(table));
+            _table.store(table, std::memory_order_release);
+            return *entry;
+        }
+        
+        // Only when nothing else can be using the table
+        void clear() {
+            _table.store(nullptr, std::memory_order_relaxed);
+            _tables.clear();
+            _entries.clear();
+        }
+    };
+    
+    class resolve_all_view {
+    public:
+        virtual ~resolve_all_view() {
+        }
     };
     
     template <class IFace>
-    class TypedServiceLocator : public AnyServiceLocator {
+    class typed_resolve_all_view;
+    
+    // Bump allocator owned by a ServiceLocator created by enterArena().  Nothing is freed individually, the
+    // blocks are freed together once the ServiceLocator and every instance placed in the arena are gone
+    class Arena {
+    private:
+        Arena& operator=(const Arena&) = delete; // non copyable
+        Arena(const Arena&) = delete;            // non construction-copyable
+        
+        // Only the thread which created the arena allocates from it, so the bump pointer needs no lock
+        std::thread::id _owner;
+        size_t _blockSize;
+        // Blocks after the first (which the Arena itself is placed at the start of) begin with a pointer to
+        // the block before them, _blocks is the latest of them
+        char* _blocks;
+        char* _next;
+        char* _end;
+        
+        // One for the ServiceLocator plus one for each instance placed in the arena (which may be released
+        // on any thread), the arena deletes itself when the last is released
+        std::atomic<size_t> _references;
+        
+        Arena(size_t blockSize, char* end) :
+            _owner(std::this_thread::get_id()),
+            _blockSize(blockSize),
+            _blocks(nullptr),
+            _next(reinterpret_cast<char*>(this + 1)),
+            _end(end),
+            _references(1) {
+        }
+        
+        ~Arena() {
+            while (_blocks != nullptr) {
+                auto previous = *reinterpret_cast<char**>(_blocks);
+                ::operator delete(_blocks);
+                _blocks = previous;
+            }
+        }
+        
     public:
-        class shared_ptr_binding : public loose_binding {
-        private:
-            std::function<sptr<IFace>(sptr<Context>)> _fnGet;
-            std::function<sptr<IFace>(sptr<Context>)> _fnCreate;
-            
-            // Note, this is used during binding only ..
-            std::list<loose_binding*>* _eagerBindings;
-
-        public:
-            class eagerly_clause {
-            private:
-                shared_ptr_binding* _ibinding;
-                
-            public:
-                eagerly_clause(shared_ptr_binding* ibinding) : _ibinding(ibinding) {
-                }
-                
-                void eagerly() {
-                    _ibinding->_eagerBindings->push_back(_ibinding);
-                }
+        // The Arena is placed at the start of its first block, so entering an arena allocates only once
+        static Arena* create(size_t blockSize) {
+            blockSize = std::max(blockSize, 2 * sizeof(Arena));
+            auto block = static_cast<char*>(::operator new(blockSize));
+            return new (block) Arena(blockSize, block + blockSize);
+        }
+        
+        bool owned() const {
+            return _owner == std::this_thread::get_id();
+        }
+        
+        void release() {
+            if (_references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                this->~Arena();
+                ::operator delete(this);
+            }
+        }
+        
+        // Only on the owning thread
+        void* allocate(size_t size, size_t alignment) {
+            _references.fetch_add(1, std::memory_order_relaxed);
+            auto aligned = [alignment] (char* p) {
+                return (char*)(((uintptr_t)p + alignment - 1) & ~(uintptr_t)(alignment - 1));
             };
-            
-            class as_clause {
+            auto p = aligned(_next);
+            if (p + size > _end) {
+                auto blockSize = std::max(_blockSize, sizeof(char*) + size + alignment);
+                auto block = static_cast<char*>(::operator new(blockSize));
+                *reinterpret_cast<char**>(block) = _blocks;
+                _blocks = block;
+                _end = block + blockSize;
+                p = aligned(block + sizeof(char*));
+            }
+            _next = p + size;
+            return p;
+        }
+    };
+    
+    // Allocates from an Arena, each allocation keeps the Arena alive until it is deallocated so instances
+    // can outlive their ServiceLocator.  Copies of the allocator (allocate_shared makes several) take no
+    // references themselves
+    template <class T>
+    class arena_allocator {
+        template <class U>
+        friend class arena_allocator;
+        
+    private:
+        Arena* _arena;
+        
+    public:
+        typedef T value_type;
+        
+        explicit arena_allocator(Arena* arena) : _arena(arena) {
+        }
+        
+        template <class U>
+        arena_allocator(const arena_allocator<U>& other) : _arena(other._arena) {
+        }
+        
+        T* allocate(size_t n) {
+            return static_cast<T*>(_arena->allocate(n * sizeof(T), alignof(T)));
+        }
+        
+        void deallocate(T*, size_t) {
+            _arena->release();
+        }
+        
+        template <class U>
+        bool operator==(const arena_allocator<U>& other) const {
+            return _arena == other._arena;
+        }
+        
+        template <class U>
+        bool operator!=(const arena_allocator<U>& other) const {
+            return _arena != other._arena;
+        }
+    };
+    
+    // Constructs TImpl from arguments listed in braces, which (unlike a function call's arguments) are
+    // evaluated left to right
+    template <class TImpl>
+    struct ordered_make {
+        sptr<TImpl> instance;
+        
+        template <class... TArgs>
+        ordered_make(Context& slc, TArgs&&... args) : instance(slc.make<TImpl>(std::forward<TArgs>(args)...)) {
+        }
+    };
+    
+    // One construction of a compiled resolve plan, see compile()
+    class plan_step {
+    public:
+        virtual ~plan_step() {
+        }
+        
+        // Take the next of a list of dependency steps
+        static plan_step& next(const sptr<plan_step>*& steps) {
+            return **steps++;
+        }
+    };
+    
+    template <class IFace>
+    class typed_plan_step;
+    
+    // The bindings being compiled, to find recursion and for error messages, plus the steps already compiled
+    // so that a binding depended on by several others is only compiled once
+    struct compile_path {
+        std::vector<const void*> bindings;
+        std::vector<std::string> frames;
+        std::map<const void*, sptr<plan_step>> compiled;
+        
+        std::string str(const std::string& frame) const {
+            std::string path;
+            for(auto& f : frames) {
+                path += f + " -> ";
+            }
+            return path + frame;
+        }
+    };
+    
+    typedef sptr<plan_step> (*FnCompile)(ServiceLocator& sl, compile_path& path);
+    
+    // Resolves one constructor argument of a toConstructor<TImpl, TDeps...>() binding, TDep is resolved
+    // as an (un-named) sptr<TDep>
+    template <class TDep>
+    struct dependency {
+        typedef sptr<TDep> type;
+        
+        static type resolve(Context& slc) {
+            return slc.resolve<TDep>();
+        }
+        
+        static sptr<plan_step> compile(ServiceLocator& sl, compile_path& path) {
+            return sl.compileStep<TDep>(Context::noName(), path);
+        }
+        
+        // Resolve by running the step compile() returned
+        static type resolve(Context& slc, plan_step& step) {
+            return static_cast<typed_plan_step<TDep>&>(step).run(slc);
+        }
+    };
+    
+public:
+    // A deferred dependency, IFace is only resolved the first time the Lazy is dereferenced (from the
+    // ServiceLocator the Lazy was created from, as a new root resolve).  The instance is then kept so
+    // dereferencing again is a single atomic load.  Copies share the instance, and any number of threads
+    // can dereference a Lazy, IFace is resolved once.  A Lazy created from a Scope must be first dereferenced
+    // before the Scope ends, afterwards it throws.
+    //
+    // Once resolved a Lazy owns its instance, so singletons which reach each other (or themselves) through
+    // Lazy dependencies own each other and are never destroyed, bind one of them transient
+    //
+    // Inject one with toConstructor<TImpl, ServiceLocator::Lazy<IFace>>() or create one with slc->lazy<IFace>()
+    template <class IFace>
+    class Lazy {
+        friend class ServiceLocator;
+        
+    private:
+        struct state {
+            // Weak so that a singleton holding a Lazy does not keep its ServiceLocator alive
+            wptr<ServiceLocator> sl;
+            uint64_t scopeGeneration;
+            Name name;
+            instance_slot<IFace> instance;
+            
+            state(const ServiceLocator& sl, const Name& name) :
+                sl(sl._this),
+                scopeGeneration(sl._scopeGeneration.load(std::memory_order_relaxed)),
+                name(name),
+                instance() {
+            }
+        };
+        
+        sptr<state> _state;
+        
+        Lazy(const ServiceLocator& sl, const Name& name) : _state(std::make_shared<state>(sl, name)) {
+        }
+        
+        sptr<IFace> resolve() const {
+            auto sl = _state->sl.lock();
+            if (sl == nullptr) {
+                throw UnableToResolveException(std::string("Unable to resolve <") + Context::getTypeName(std::type_index(typeid(IFace))) + ">  the ServiceLocator has been destroyed");
+            }
+            if (sl->_scopeGeneration.load(std::memory_order_acquire) != _state->scopeGeneration) {
+                throw UnableToResolveException(std::string("Unable to resolve <") + Context::getTypeName(std::type_index(typeid(IFace))) + ">  the Scope it was created in has ended");
+            }
+            Context ctx(sl.get(), std::type_index(typeid(IFace)), _state->name);
+            return _state->instance.get(ctx, [&sl, &ctx] () {
+                ctx.checkRecursiveResolve<IFace>();
+                auto ptr = sl->template _resolve<IFace>(ctx);
+                ctx.afterResolve();
+                return ptr;
+            });
+        }
+        
+    public:
+        const sptr<IFace>& get() const {
+            if (!_state->instance.constructed()) {
+                resolve();
+            }
+            return _state->instance.value();
+        }
+        
+        IFace* operator->() const {
+            return get().get();
+        }
+        
+        IFace& operator*() const {
+            return *get();
+        }
+    };
+    
+    // The outcome of Context::resolveResult(), either the resolved instance or an error.  Neither it nor a
+    // failed resolve throws, eg
+    //   auto plugin = slc->resolveResult<IPlugin>(pluginName);
+    //   if (plugin) {
+    //       plugin.value()->handle(message);
+    //   }
+    template <class IFace>
+    class ResolveResult {
+        friend class Context;
+        
+    private:
+        sptr<IFace> _value;
+        ResolveError _error;
+        Name _name;
+        // Only set when resolving threw, an unbound interface renders its message on request
+        std::string _message;
+        
+        ResolveResult(const sptr<IFace>& value) : _value(value), _error(ResolveError::None), _name(Context::noName()), _message() {
+        }
+        
+        ResolveResult(ResolveError error, const Name& name) : _value(), _error(error), _name(name), _message() {
+        }
+        
+        ResolveResult(ResolveError error, const Name& name, const std::string& message) : _value(), _error(error), _name(name), _message(message) {
+        }
+        
+        // Renders the message of a failed result whilst its (not interned) name is still valid, then drops the name
+        void detach() {
+            _message = getMessage();
+            _name = Context::noName();
+        }
+        
+    public:
+        bool ok() const {
+            return _error == ResolveError::None;
+        }
+        
+        explicit operator bool() const {
+            return ok();
+        }
+        
+        ResolveError error() const {
+            return _error;
+        }
+        
+        // nullptr unless ok()
+        const sptr<IFace>& value() const {
+            return _value;
+        }
+        
+        // Describes the error, empty if ok()
+        std::string getMessage() const {
+            if (_error == ResolveError::Unbound && _message.empty()) {
+                return "Unable to resolve <" + Context::getTypeName(std::type_index(typeid(IFace))) + ">  resolve path = resolve<" + Context::getTypeName(std::type_index(typeid(IFace))) + ">(" + _name.str() + ")";
+            }
+            return _message;
+        }
+    };
+    
+private:
+    // A Lazy dependency is only checked to be bound, it is not compiled into the plan (being lazy it may
+    // refer back to its dependant)
+    template <class TDep>
+    struct dependency<Lazy<TDep>> {
+        typedef Lazy<TDep> type;
+        
+        static type resolve(Context& slc) {
+            return Lazy<TDep>(*slc._sl, Context::noName());
+        }
+        
+        static sptr<plan_step> compile(ServiceLocator& sl, compile_path& path) {
+            if (sl.findBinding<TDep>(Context::noName()) == nullptr) {
+                auto frame = "resolve<" + Context::getTypeName(std::type_index(typeid(TDep))) + ">()";
+                throw UnableToResolveException("Unable to resolve <" + Context::getTypeName(std::type_index(typeid(TDep))) + ">  resolve path = " + path.str(frame));
+            }
+            return sptr<plan_step>(new plan_step());
+        }
+        
+        static type resolve(Context& slc, plan_step&) {
+            return resolve(slc);
+        }
+    };
+    
+#ifdef SERVICELOCATOR_STATS
+public:
+    struct BindingStats {
+        std::string interfaceType;
+        std::string name;
+        uint64_t resolves;
+        // constructions of new instances (transients, first resolve of singletons)
+        uint64_t constructions;
+        // resolves returning a singleton or instance without constructing
+        uint64_t cacheHits;
+        // construction times include the construction of any dependencies
+        std::chrono::nanoseconds totalConstructionTime;
+        std::chrono::nanoseconds maxConstructionTime;
+        
+        double cacheHitRate() const {
+            return resolves == 0 ? 0 : (double)cacheHits / resolves;
+        }
+    };
+    
+private:
+    // Counters are striped so that threads mostly update their own cache line rather than all contending
+    // on the same counters, a thread always uses the same stripe
+    class binding_stats {
+    private:
+        static const size_t Stripes = 16;
+        
+        // One cache line each so threads counting on different stripes do not share a line
+        struct alignas(64) stripe {
+            std::atomic<uint64_t> resolves;
+            std::atomic<uint64_t> constructions;
+            std::atomic<uint64_t> cacheHits;
+            std::atomic<uint64_t> totalNs;
+            std::atomic<uint64_t> maxNs;
+        };
+        
+        // operator new only honours alignas beyond alignof(std::max_align_t) from C++17, so the stripes are
+        // placed at the first cache line boundary within _storage rather than relying on the binding's alignment
+        unsigned char _storage[sizeof(stripe) * (Stripes + 1)];
+        stripe* _stripes;
+        
+        binding_stats& operator=(const binding_stats&) = delete; // non copyable, _stripes points into _storage
+        binding_stats(const binding_stats&) = delete;            // non construction-copyable
+        
+        static stripe& threadStripe(stripe* stripes) {
+            static std::atomic<size_t> next(0);
+            static thread_local size_t index = next.fetch_add(1, std::memory_order_relaxed) % Stripes;
+            return stripes[index];
+        }
+        
+    public:
+        binding_stats() {
+            auto address = reinterpret_cast<uintptr_t>(_storage);
+            _stripes = reinterpret_cast<stripe*>((address + alignof(stripe) - 1) & ~uintptr_t(alignof(stripe) - 1));
+            for(size_t i = 0; i < Stripes; i++) {
+                auto counts = new (&_stripes[i]) stripe();
+                counts->resolves = 0;
+                counts->constructions = 0;
+                counts->cacheHits = 0;
+                counts->totalNs = 0;
+                counts->maxNs = 0;
+            }
+        }
+        
+        void resolved() {
+            threadStripe(_stripes).resolves.fetch_add(1, std::memory_order_relaxed);
+        }
+        
+        void cacheHit() {
+            threadStripe(_stripes).cacheHits.fetch_add(1, std::memory_order_relaxed);
+        }
+        
+        void constructed(std::chrono::steady_clock::duration duration) {
+            uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+            auto& stripe = threadStripe(_stripes);
+            stripe.constructions.fetch_add(1, std::memory_order_relaxed);
+            stripe.totalNs.fetch_add(ns, std::memory_order_relaxed);
+            auto max = stripe.maxNs.load(std::memory_order_relaxed);
+            while (ns > max && !stripe.maxNs.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+            }
+        }
+        
+        void collect(BindingStats& stats) const {
+            stats.resolves = stats.constructions = stats.cacheHits = 0;
+            uint64_t totalNs = 0;
+            uint64_t maxNs = 0;
+            for(size_t i = 0; i < Stripes; i++) {
+                auto& stripe = _stripes[i];
+                stats.resolves += stripe.resolves.load(std::memory_order_relaxed);
+                stats.constructions += stripe.constructions.load(std::memory_order_relaxed);
+                stats.cacheHits += stripe.cacheHits.load(std::memory_order_relaxed);
+                totalNs += stripe.totalNs.load(std::memory_order_relaxed);
+                maxNs = std::max(maxNs, stripe.maxNs.load(std::memory_order_relaxed));
+            }
+            stats.totalConstructionTime = std::chrono::nanoseconds(totalNs);
+            stats.maxConstructionTime = std::chrono::nanoseconds(maxNs);
+        }
+    };
+#endif
+    
+    class frozen_table;
+    
+    class AnyServiceLocator {
+    public:
+        virtual ~AnyServiceLocator() {
+        }
+        
+        virtual size_t bindingCount() const = 0;
+        
+        // Add this locator's bindings, of the interface with typeSlot() type, to table
+        virtual void freezeInto(size_t type, frozen_table& table) const = 0;
+        
+        // Create a new locator holding this locator's bindings plus any of parent's bindings not
+        // overridden here, parent is always a locator for the same interface
+        virtual sptr<AnyServiceLocator> mergedWith(const AnyServiceLocator& parent) const = 0;
+        
+        // Compile every binding as resolved from sl, throws on the first unresolvable or recursive dependency
+        virtual void compileAll(ServiceLocator& sl, compile_path& path) const = 0;
+        
+#ifdef SERVICELOCATOR_STATS
+        virtual void collectStats(std::vector<BindingStats>& stats) const = 0;
+#endif
+        
+        class loose_binding {
+        public:
+            virtual ~loose_binding() {
+            }
+            
+            virtual void eagerBind(Context& slc) = 0;
+            virtual std::type_index getInterfaceType() const = 0;
+            virtual const Name& getName() const = 0;
+        };
+    };
+    
+    // Every binding visible from a frozen ServiceLocator, of every interface, in one open addressing table
+    // keyed by (typeSlot(), name).  The capacity is a power of 2 at least twice the number of bindings, a
+    // frozen resolve is a probe of this one array rather than a walk through the per interface locators
+    class frozen_table {
+    private:
+        struct entry {
+            size_t type;
+            size_t hash;
+            const std::string* name;
+            AnyServiceLocator::loose_binding* binding;
+        };
+        std::vector<entry> _entries;
+        size_t _mask;
+        
+        static size_t slotOf(size_t type, size_t hash) {
+            return hash + type * size_t(0x9E3779B97F4A7C15ull);
+        }
+        
+    public:
+        frozen_table(size_t bindings) : _entries(), _mask(0) {
+            size_t capacity = 4;
+            while (capacity < bindings * 2) {
+                capacity *= 2;
+            }
+            _entries.resize(capacity, entry{0, 0, nullptr, nullptr});
+            _mask = capacity - 1;
+        }
+        
+        AnyServiceLocator::loose_binding* find(size_t type, const Name& name) const {
+            for(auto i = slotOf(type, name._hash) & _mask; _entries[i].binding != nullptr; i = (i + 1) & _mask) {
+                auto& e = _entries[i];
+                if (e.type == type && (e.name == name._name || (!name._interned && e.hash == name._hash && *e.name == *name._name))) {
+                    return e.binding;
+                }
+            }
+            return nullptr;
+        }
+        
+        // Bindings are added child first, a parent's binding of the same interface and name is hidden
+        void insert(size_t type, const Name& name, AnyServiceLocator::loose_binding* binding) {
+            auto i = slotOf(type, name._hash) & _mask;
+            for(; _entries[i].binding != nullptr; i = (i + 1) & _mask) {
+                if (_entries[i].type == type && _entries[i].name == name._name) {
+                    return;
+                }
+            }
+            _entries[i] = entry{type, name._hash, name._name, binding};
+        }
+    };
+    
+    template <class IFace>
+    class TypedServiceLocator : public AnyServiceLocator {
+    public:
+        class shared_ptr_binding : public loose_binding {
+        private:
+            // What resolving this binding does, the instance (toInstance or a constructed singleton) is
+            // checked first so a singleton hit is a single acquire load
+            enum Lifetime { Unbound, Instance, Transient, Singleton, ThreadLocal, Scoped };
+            
+            // Creates a new instance, set by the to_clause.  Creation functions which need more than the
+            // binding and Context (user functions, alias names) keep their state in _state
+            typedef sptr<IFace> (*FnCreate)(const shared_ptr_binding& binding, Context& slc);
+            
+            // Bindings which declare their dependencies (toConstructor) can also create from the steps of a
+            // compiled plan, _dependencies is a nullptr terminated list compiling each dependency's step
+            typedef sptr<IFace> (*FnCreatePlanned)(const shared_ptr_binding& binding, Context& slc, const sptr<plan_step>* dependencies);
+            
+            Lifetime _lifetime;
+            FnCreate _fnCreate;
+            FnCreatePlanned _fnCreatePlanned;
+            const FnCompile* _dependencies;
+            sptr<const void> _state;
+            instance_slot<IFace> _instance;
+            
+            // Only acquired by asThreadLocal() and asScoped(), generation 0 is no slot
+            size_t _slot;
+            uint64_t _slotGeneration;
+            
+            // Each thread's asThreadLocal() instance, released with the binding.  Guarded by bindingSlotMutex(),
+            // only taken once per thread
+            std::vector<wptr<thread_local_cell>> _threadLocalCells;
+#ifdef SERVICELOCATOR_STATS
+            binding_stats _stats;
+#endif
+            
+            // Note, this is used during binding only ..
+            std::list<loose_binding*>* _eagerBindings;
+            
+            template <class TState>
+            const TState& state() const {
+                return *static_cast<const TState*>(_state.get());
+            }
+            
+            template <class FnConstruct>
+            sptr<IFace> construct(const FnConstruct& fnConstruct) {
+#ifdef SERVICELOCATOR_STATS
+                auto start = std::chrono::steady_clock::now();
+                auto instance = fnConstruct();
+                _stats.constructed(std::chrono::steady_clock::now() - start);
+                return instance;
+#else
+                return fnConstruct();
+#endif
+            }
+            
+            template <class FnConstruct>
+            sptr<IFace> getThreadLocal(const FnConstruct& fnConstruct) {
+                auto& instances = threadLocalInstances();
+                if (_slot < instances.size() && instances[_slot].generation == _slotGeneration) {
+#ifdef SERVICELOCATOR_STATS
+                    _stats.cacheHit();
+#endif
+                    return std::static_pointer_cast<IFace>(instances[_slot].cell->instance);
+                }
+                
+                // constructing may add other thread local instances, so only index instances afterwards
+                auto instance = construct(fnConstruct);
+                auto cell = std::make_shared<thread_local_cell>();
+                cell->instance = std::const_pointer_cast<typename std::remove_const<IFace>::type>(instance);
+                {
+                    std::lock_guard<std::mutex> lock(bindingSlotMutex());
+                    // drop cells of threads which have exited before growing
+                    if (_threadLocalCells.size() == _threadLocalCells.capacity()) {
+                        _threadLocalCells.erase(std::remove_if(_threadLocalCells.begin(), _threadLocalCells.end(), [] (const wptr<thread_local_cell>& cell) {
+                            return cell.expired();
+                        }), _threadLocalCells.end());
+                    }
+                    _threadLocalCells.push_back(cell);
+                }
+                if (_slot >= instances.size()) {
+                    instances.resize(_slot + 1);
+                }
+                instances[_slot].generation = _slotGeneration;
+                instances[_slot].cell = std::move(cell);
+                return instance;
+            }
+            
+            template <class FnConstruct>
+            sptr<IFace> get(Context& slc, const FnConstruct& fnConstruct) {
+#ifdef SERVICELOCATOR_STATS
+                _stats.resolved();
+#endif
+                if (_instance.constructed()) {
+#ifdef SERVICELOCATOR_STATS
+                    _stats.cacheHit();
+#endif
+                    return _instance.value();
+                }
+                switch(_lifetime) {
+                    case Transient:
+                        slc._transient = true;
+                        return construct(fnConstruct);
+                    case Singleton:
+                        slc._cached = true;
+                        return _instance.get(slc, [this, &fnConstruct] () {
+                            return construct(fnConstruct);
+                        });
+                    case ThreadLocal:
+                        slc._cached = true;
+                        return getThreadLocal(fnConstruct);
+                    case Scoped: {
+                        slc._cached = true;
+                        auto& scoped = slc._sl->scopedEntry(_slot, _slotGeneration).instance;
+#ifdef SERVICELOCATOR_STATS
+                        if (scoped.constructed()) {
+                            _stats.cacheHit();
+                        }
+#endif
+                        return std::static_pointer_cast<IFace>(scoped.get(slc, [this, &fnConstruct] () {
+                            return sptr<void>(std::const_pointer_cast<typename std::remove_const<IFace>::type>(construct(fnConstruct)));
+                        }));
+                    }
+                    default:
+                        throw BindingIssueException("Binding has nothing to resolve to, resolve path = " + slc.getResolvePath());
+                }
+            }
+            
+            void create(FnCreate fnCreate) {
+                _lifetime = Transient;
+                _fnCreate = fnCreate;
+            }
+            
+            template <class TState>
+            void create(FnCreate fnCreate, const TState& state) {
+                create(fnCreate);
+                _state = sptr<const void>(new TState(state));
+            }
+
+        public:
+            class eagerly_clause {
+            private:
+                shared_ptr_binding* _ibinding;
+                
+            public:
+                eagerly_clause(shared_ptr_binding* ibinding) : _ibinding(ibinding) {
+                }
+                
+                void eagerly() {
+                    _ibinding->_eagerBindings->push_back(_ibinding);
+                }
+            };
+            
+            class as_clause {
             private:
-                sptr<IFace> _singleton;
                 shared_ptr_binding* _ibinding;
                 
             public:
@@ -372,24 +1658,31 @@ private:
                 }
                 
                 eagerly_clause& asSingleton() {
-                    // on 1st call we create the singleton ..
-                    _ibinding->_fnGet = [this] (sptr<Context> slc) {
-                        _singleton = _ibinding->_fnCreate(slc);
-                        
-                        auto singleton = _singleton;
-                        
-                        // rebind fnGet to return the new singleton
-                        _ibinding->_fnGet = [this] (sptr<Context> slc) {
-                            return _singleton;
-                        };
-                        
-                        return singleton;
-                    };
+                    // on 1st resolve we create the singleton, any other thread resolving it meanwhile waits for it
+                    _ibinding->_lifetime = Singleton;
                     return _ibinding->_eagerly_clause;
                 }
 
                 void asTransient() {
-                    _ibinding->_fnGet = _ibinding->_fnCreate;
+                    _ibinding->_lifetime = Transient;
+                }
+                
+                // One instance per thread, for instances which are not thread safe (parsers, buffers ..).
+                // Each thread's instance is destroyed when the thread exits or the binding is destroyed
+                void asThreadLocal() {
+                    _ibinding->_lifetime = ThreadLocal;
+                    if (_ibinding->_slotGeneration == 0) {
+                        acquireBindingSlot(_ibinding->_slot, _ibinding->_slotGeneration);
+                    }
+                }
+                
+                // One instance per ServiceLocator resolved from, bound once in a parent each child from enter()
+                // (eg one per request) gets its own instance which is released with the child
+                void asScoped() {
+                    _ibinding->_lifetime = Scoped;
+                    if (_ibinding->_slotGeneration == 0) {
+                        acquireBindingSlot(_ibinding->_slot, _ibinding->_slotGeneration);
+                    }
                 }
             };
 
@@ -402,95 +1695,136 @@ private:
                 }
                 
                 void toInstance(sptr<IFace> instance) {
-                    // fnCreate is not needed, we always return 'instance'
-                    _ibinding->_fnGet = [instance] (sptr<Context> slc) {
-                        return instance;
-                    };
+                    // no creation function is needed, we always return 'instance'
+                    _ibinding->_lifetime = Instance;
+                    _ibinding->_instance.set(instance);
                 }
 
                 void toInstance(IFace* instance) {
-                    auto cached = sptr<IFace>(instance);
-                    // fnCreate is not needed, we always return 'instance'
-                    _ibinding->_fnGet = [cached] (sptr<Context> slc) {
-                        return cached;
-                    };
+                    toInstance(sptr<IFace>(instance));
                 }
 
                 as_clause& toSelf() {
-                    _ibinding->_fnGet = _ibinding->_fnCreate = [] (sptr<Context> slc) {
-                        slc->setConcreteType(std::type_index(typeid(IFace)));
-                        return sptr<IFace>(new IFace(slc));
-                    };
+                    _ibinding->create([] (const shared_ptr_binding&, Context& slc) {
+                        slc.setConcreteType(std::type_index(typeid(IFace)));
+                        return slc.make<IFace>(Context::borrow(slc));
+                    });
                     return _ibinding->_as_clause;
                 }
                 
                 as_clause& toSelfNoDependancy() {
-                    _ibinding->_fnGet = _ibinding->_fnCreate = [] (sptr<Context> slc) {
-                        slc->setConcreteType(std::type_index(typeid(IFace)));
-                        return sptr<IFace>(new IFace());
-                    };
+                    _ibinding->create([] (const shared_ptr_binding&, Context& slc) {
+                        slc.setConcreteType(std::type_index(typeid(IFace)));
+                        return slc.make<IFace>();
+                    });
                     return _ibinding->_as_clause;
                 }
                 
                 template <class TImpl>
                 as_clause& to() {
-                    _ibinding->_fnGet = _ibinding->_fnCreate = [] (sptr<Context> slc) {
-                        slc->setConcreteType(std::type_index(typeid(TImpl)));
-                        return sptr<TImpl>(new TImpl(slc));
+                    _ibinding->create([] (const shared_ptr_binding&, Context& slc) {
+                        slc.setConcreteType(std::type_index(typeid(TImpl)));
+                        return sptr<IFace>(slc.make<TImpl>(Context::borrow(slc)));
+                    });
+                    return _ibinding->_as_clause;
+                }
+                
+                // Bind to TImpl constructed with its dependencies, TImpl(sptr<TDeps>...), eg
+                //   bind<IAnimal>().toConstructor<Monkey, IFood>();
+                // resolves IFood and calls new Monkey(food) - TImpl does not need to know about ServiceLocator.
+                // The dependencies are resolved in the order they are listed
+                template <class TImpl, class... TDeps>
+                as_clause& toConstructor() {
+                    _ibinding->create([] (const shared_ptr_binding&, Context& slc) {
+                        slc.setConcreteType(std::type_index(typeid(TImpl)));
+                        return sptr<IFace>(ordered_make<TImpl>{slc, dependency<TDeps>::resolve(slc)...}.instance);
+                    });
+                    static const FnCompile dependencies[] = { &dependency<TDeps>::compile..., nullptr };
+                    _ibinding->_dependencies = dependencies;
+                    _ibinding->_fnCreatePlanned = [] (const shared_ptr_binding&, Context& slc, const sptr<plan_step>* dependencies) {
+                        slc.setConcreteType(std::type_index(typeid(TImpl)));
+                        return sptr<IFace>(ordered_make<TImpl>{slc, dependency<TDeps>::resolve(slc, plan_step::next(dependencies))...}.instance);
                     };
                     return _ibinding->_as_clause;
                 }
                 
+                // Bind to TImpl(SLContext_sptr) allocated, along with its shared_ptr control block, by alloc (a
+                // standard Allocator) eg a pool allocator for a transient which is created very often
+                template <class TImpl, class TAlloc>
+                as_clause& toAllocated(const TAlloc& alloc) {
+                    _ibinding->create([] (const shared_ptr_binding& binding, Context& slc) {
+                        slc.setConcreteType(std::type_index(typeid(TImpl)));
+                        return sptr<IFace>(std::allocate_shared<TImpl>(binding.template state<TAlloc>(), Context::borrow(slc)));
+                    }, alloc);
+                    return _ibinding->_as_clause;
+                }
+                
                 template <class TImpl>
                 as_clause& toNoDependancy() {
-                    _ibinding->_fnGet = _ibinding->_fnCreate = [] (sptr<Context> slc) {
-                        slc->setConcreteType(std::type_index(typeid(TImpl)));
-                        return sptr<TImpl>(new TImpl());
-                    };
+                    _ibinding->create([] (const shared_ptr_binding&, Context& slc) {
+                        slc.setConcreteType(std::type_index(typeid(TImpl)));
+                        return sptr<IFace>(slc.make<TImpl>());
+                    });
                     return _ibinding->_as_clause;
                 }
                 
                 template <class TImpl>
                 as_clause& to(std::function<sptr<TImpl>(sptr<Context>)> fnCreate) {
-                    _ibinding->_fnGet = _ibinding->_fnCreate = [fnCreate] (sptr<Context> slc) {
-                        slc->setConcreteType(std::type_index(typeid(TImpl)));
-                        return fnCreate(slc);
-                    };
+                    typedef std::function<sptr<TImpl>(sptr<Context>)> fn_type;
+                    _ibinding->create([] (const shared_ptr_binding& binding, Context& slc) {
+                        slc.setConcreteType(std::type_index(typeid(TImpl)));
+                        return sptr<IFace>(binding.template state<fn_type>()(Context::borrow(slc)));
+                    }, fnCreate);
                     return _ibinding->_as_clause;
                 }
 
                 // similar to above, except caller can return IFace* instead of sptr<IFace>
                 template <class TImpl>
                 as_clause& to(std::function<TImpl*(sptr<Context>)> fnCreate) {
-                    _ibinding->_fnGet = _ibinding->_fnCreate = [fnCreate] (sptr<Context> slc) {
-                        slc->setConcreteType(std::type_index(typeid(TImpl)));
+                    typedef std::function<TImpl*(sptr<Context>)> fn_type;
+                    _ibinding->create([] (const shared_ptr_binding& binding, Context& slc) {
+                        slc.setConcreteType(std::type_index(typeid(TImpl)));
                         // create sptr around the returned ptr
-                        auto ptr = fnCreate(slc);
-                        return sptr<TImpl>(ptr);
-                    };
+                        return sptr<IFace>(binding.template state<fn_type>()(Context::borrow(slc)));
+                    }, fnCreate);
+                    return _ibinding->_as_clause;
+                }
+                
+                // Bind to TImpl created by a function returning a std::future, eg one from std::async which loads
+                // a file or waits on dependencies from slc->resolveAsync().  Resolving waits for the future.  The
+                // Context handed to the function is the resolving thread's stack frame and must only be used on
+                // that thread, work on other threads resolves through slc->resolveAsync() or a ServiceLocator
+                // captured from slc->getServiceLocator()
+                template <class TImpl>
+                as_clause& toAsync(std::function<std::future<sptr<TImpl>>(sptr<Context>)> fnCreate) {
+                    typedef std::function<std::future<sptr<TImpl>>(sptr<Context>)> fn_type;
+                    _ibinding->create([] (const shared_ptr_binding& binding, Context& slc) {
+                        slc.setConcreteType(std::type_index(typeid(TImpl)));
+                        return sptr<IFace>(binding.template state<fn_type>()(Context::borrow(slc)).get());
+                    }, fnCreate);
                     return _ibinding->_as_clause;
                 }
                 
                 as_clause& alias(const std::string& name) {
-                    _ibinding->_fnGet = _ibinding->_fnCreate = [name] (sptr<Context> slc) {
-                        return slc->resolve<IFace>(name);
-                    };
+                    _ibinding->create([] (const shared_ptr_binding& binding, Context& slc) {
+                        return slc.resolve<IFace>(binding.template state<Name>());
+                    }, ServiceLocator::name(name));
                     return _ibinding->_as_clause;
                 }
 
                 template <class IAlias>
                 as_clause& alias() {
-                    _ibinding->_fnGet = _ibinding->_fnCreate = [] (sptr<Context> slc) {
-                        return slc->resolve<IAlias>(slc->getName());
-                    };
+                    _ibinding->create([] (const shared_ptr_binding&, Context& slc) {
+                        return sptr<IFace>(slc.resolve<IAlias>(slc._name));
+                    });
                     return _ibinding->_as_clause;
                 }
                 
                 template <class IAlias>
                 as_clause& alias(const std::string& name) {
-                    _ibinding->_fnGet = _ibinding->_fnCreate = [name] (sptr<Context> slc) {
-                        return slc->resolve<IAlias>(name);
-                    };
+                    _ibinding->create([] (const shared_ptr_binding& binding, Context& slc) {
+                        return sptr<IFace>(slc.resolve<IAlias>(binding.template state<Name>()));
+                    }, ServiceLocator::name(name));
                     return _ibinding->_as_clause;
                 }
 
@@ -500,91 +1834,510 @@ private:
             as_clause _as_clause;
             eagerly_clause _eagerly_clause;
             
+            // Interned name this binding was bound with
+            const Name _name;
+            
         public:
-            shared_ptr_binding(std::list<loose_binding*>* eagerBindings)
+            shared_ptr_binding(const Name& name, std::list<loose_binding*>* eagerBindings)
                 :
+                _lifetime(Unbound),
+                _fnCreate(nullptr),
+                _fnCreatePlanned(nullptr),
+                _dependencies(nullptr),
+                _state(),
+                _instance(),
+                _slot(0),
+                _slotGeneration(0),
+                _threadLocalCells(),
                 _eagerBindings(eagerBindings),
                 _to_clause(this),
                 _as_clause(this),
-                _eagerly_clause(this) {
+                _eagerly_clause(this),
+                _name(name) {
+            }
+            
+            ~shared_ptr_binding() {
+                if (_slotGeneration != 0) {
+                    // released outside the lock, an instance's destructor may itself destroy bindings
+                    std::vector<sptr<void>> threadLocals;
+                    {
+                        std::lock_guard<std::mutex> lock(bindingSlotMutex());
+                        for (auto& weakCell : _threadLocalCells) {
+                            if (auto cell = weakCell.lock()) {
+                                threadLocals.push_back(std::move(cell->instance));
+                            }
+                        }
+                    }
+                    threadLocals.clear();
+                    releaseBindingSlot(_slot);
+                }
+            }
+            
+            sptr<IFace> get(Context& slc) {
+                return get(slc, [this, &slc] () {
+                    return _fnCreate(*this, slc);
+                });
+            }
+            
+            // A singleton which has been constructed, or an instance
+            bool constructed() const {
+                return _instance.constructed();
             }
             
-            virtual sptr<IFace> get(sptr<Context> slc) const {
-                return _fnGet(slc);
+            // nullptr unless the binding declared its dependencies
+            const FnCompile* getDependencies() const {
+                return _dependencies;
             }
             
-            void eagerBind(sptr<Context> slc) override {
-                auto ctx = sptr<Context>(new Context(slc.get(), std::type_index(typeid(IFace)), ""));
-                _fnGet(ctx);
+            // Resolve from a compiled plan, dependencies are the steps compiled from _dependencies.  Bindings
+            // which did not declare their dependencies resolve them as usual
+            sptr<IFace> getPlanned(Context& slc, const std::vector<sptr<plan_step>>& dependencies) {
+                if (_fnCreatePlanned == nullptr) {
+                    return get(slc);
+                }
+                return get(slc, [this, &slc, &dependencies] () {
+                    return _fnCreatePlanned(*this, slc, dependencies.data());
+                });
+            }
+            
+            void eagerBind(Context& slc) override {
+                Context ctx(&slc, std::type_index(typeid(IFace)), _name);
+                ctx.checkRecursiveResolve<IFace>();
+                get(ctx);
             }
+            
+            std::type_index getInterfaceType() const override {
+                return std::type_index(typeid(IFace));
+            }
+            
+            const Name& getName() const override {
+                return _name;
+            }
+            
+#ifdef SERVICELOCATOR_STATS
+            BindingStats getStats() const {
+                BindingStats stats;
+                stats.interfaceType = Context::getTypeName(std::type_index(typeid(IFace)));
+                stats.name = _name.str();
+                _stats.collect(stats);
+                return stats;
+            }
+#endif
         };
         
-        std::map<std::string, sptr<loose_binding>> _bindings;
+        // Open addressing hash table of bindings keyed by interned name, the capacity is a power of 2
+        // and the table is kept at most half full so probe sequences stay short
+        struct binding_entry {
+            const std::string* name;
+            size_t hash;
+            shared_ptr_binding* binding;
+        };
+        std::vector<binding_entry> _table;
+        
+        // Owns the bindings, kept in name order for resolveAll
+        std::vector<sptr<shared_ptr_binding>> _bindings;
+        
+        shared_ptr_binding* find(const Name& name) const {
+            if (_table.empty()) {
+                return nullptr;
+            }
+            auto mask = _table.size() - 1;
+            for(auto i = name._hash & mask; _table[i].binding != nullptr; i = (i + 1) & mask) {
+                auto& entry = _table[i];
+                if (entry.name == name._name || (!name._interned && entry.hash == name._hash && *entry.name == *name._name)) {
+                    return entry.binding;
+                }
+            }
+            return nullptr;
+        }
+        
+        void insert(const Name& name, shared_ptr_binding* binding) {
+            if ((_bindings.size() + 1) * 2 > _table.size()) {
+                std::vector<binding_entry> old;
+                old.swap(_table);
+                _table.resize(old.empty() ? 4 : old.size() * 2, binding_entry{nullptr, 0, nullptr});
+                for(auto& entry : old) {
+                    if (entry.binding != nullptr) {
+                        place(entry);
+                    }
+                }
+            }
+            place(binding_entry{name._name, name._hash, binding});
+        }
+        
+        void adopt(const sptr<shared_ptr_binding>& binding) {
+            insert(binding->_name, binding.get());
+            
+            auto position = _bindings.begin();
+            while (position != _bindings.end() && (*position)->_name.str() < binding->_name.str()) {
+                ++position;
+            }
+            _bindings.insert(position, binding);
+        }
+        
+        void place(const binding_entry& entry) {
+            auto mask = _table.size() - 1;
+            auto i = entry.hash & mask;
+            while (_table[i].binding != nullptr) {
+                i = (i + 1) & mask;
+            }
+            _table[i] = entry;
+        }
 
     public:
-        typename shared_ptr_binding::to_clause& bind(const std::string& name, std::list<loose_binding*>* eagerBindings) {
+        typename shared_ptr_binding::to_clause& bind(const Name& name, std::list<loose_binding*>* eagerBindings) {
             if (canResolve(name)) {
-                throw DuplicateBindingException(std::string("Duplicate binding for <") + typeid(IFace).name() + "> named " + name);
+                throw DuplicateBindingException(std::string("Duplicate binding for <") + typeid(IFace).name() + "> named " + name.str());
             }
 
-            auto binding = sptr<shared_ptr_binding>(new shared_ptr_binding(eagerBindings));
-            
-            // (non const) IFace binding
-            _bindings.insert(std::pair<std::string, sptr<loose_binding>>(name, binding));
+            auto binding = sptr<shared_ptr_binding>(new shared_ptr_binding(name, eagerBindings));
+            adopt(binding);
             
             return binding->_to_clause;
         }
-
-        bool canResolve(const std::string& name) {
-            return _bindings.find(name) != _bindings.end();
+        
+        sptr<AnyServiceLocator> mergedWith(const AnyServiceLocator& parent) const override {
+            auto merged = sptr<TypedServiceLocator<IFace>>(new TypedServiceLocator<IFace>());
+            for(auto& binding : _bindings) {
+                merged->adopt(binding);
+            }
+            for(auto& binding : static_cast<const TypedServiceLocator<IFace>&>(parent)._bindings) {
+                if (!merged->canResolve(binding->_name)) {
+                    merged->adopt(binding);
+                }
+            }
+            return merged;
+        }
+
+        bool canResolve(const Name& name) const {
+            return find(name) != nullptr;
+        }
+        
+        size_t bindingCount() const override {
+            return _bindings.size();
+        }
+        
+        void freezeInto(size_t type, frozen_table& table) const override {
+            for(auto& binding : _bindings) {
+                table.insert(type, binding->_name, binding.get());
+            }
+        }
+
+        sptr<IFace> tryResolve(const Name& name, Context& slc) {
+            auto binding = find(name);
+            if (binding == nullptr) {
+                return nullptr;
+            }
+            
+            return binding->get(slc);
+        }
+        
+#ifdef SERVICELOCATOR_STATS
+        void collectStats(std::vector<BindingStats>& stats) const override {
+            for(auto& binding : _bindings) {
+                stats.push_back(binding->getStats());
+            }
+        }
+#endif
+        
+        void compileAll(ServiceLocator& sl, compile_path& path) const override {
+            for(auto& binding : _bindings) {
+                sl.compileStep<IFace>(binding->_name, path);
+            }
+        }
+        
+        void collectBindings(std::vector<shared_ptr_binding*>& bindings) const {
+            for(auto& binding : _bindings) {
+                bindings.push_back(binding.get());
+            }
+        }
+    };
+    
+    template <class IFace>
+    class typed_resolve_all_view : public resolve_all_view {
+    public:
+        std::vector<typename TypedServiceLocator<IFace>::shared_ptr_binding*> bindings;
+        
+        // Set (once) when every binding is a constructed singleton or instance, the instances then never change
+        std::atomic<const std::vector<sptr<IFace>>*> instances;
+        
+        typed_resolve_all_view() : bindings(), instances(nullptr) {
+        }
+        
+        ~typed_resolve_all_view() {
+            delete instances.load();
         }
-
-        sptr<IFace> tryResolve(const std::string& name, sptr<Context> slc) {
-            auto binding = _bindings.find(name);
-            if (binding == _bindings.end()) {
-                return nullptr;
+        
+        bool constructed() const {
+            for(auto binding : bindings) {
+                if (!binding->constructed()) {
+                    return false;
+                }
             }
-            auto ibinding = std::dynamic_pointer_cast<shared_ptr_binding>(binding->second);
-            
-            return ibinding->get(slc);
+            return true;
         }
+    };
+    
+    template <class IFace>
+    class typed_plan_step : public plan_step {
+    public:
+        typename TypedServiceLocator<IFace>::shared_ptr_binding* _binding;
+        std::vector<sptr<plan_step>> _dependencies;
         
-        void visitAll(std::function<void(sptr<TypedServiceLocator<IFace>::shared_ptr_binding>)> fnVisit) {
-            for(auto binding : _bindings) {
-                auto ibinding = std::dynamic_pointer_cast<shared_ptr_binding>(binding.second);
-                fnVisit(ibinding);
-            }
+        typed_plan_step(typename TypedServiceLocator<IFace>::shared_ptr_binding* binding) :
+            _binding(binding),
+            _dependencies() {
+        }
+        
+        sptr<IFace> run(Context& parent) {
+            Context ctx(&parent, std::type_index(typeid(IFace)), _binding->_name);
+            ctx.checkRecursiveResolve<IFace>();
+            auto ptr = _binding->getPlanned(ctx, _dependencies);
+            ctx.afterResolve();
+            return ptr;
         }
     };
     
-    // Named locator bindings (simple map from string to NamedServiceLocator)
-    std::map<std::type_index, AnyServiceLocator*> _typed_locators;
+    // Every interface type is given a process wide slot number the first time it is bound or resolved,
+    // slot numbers are small and dense so a locator can index its typed locators directly by them
+    static size_t nextTypeSlot() {
+        static std::atomic<size_t> count(0);
+        return count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    template <class IFace>
+    static size_t typeSlot() {
+        static const size_t slot = nextTypeSlot();
+        return slot;
+    }
+    
+    // Typed locator bindings indexed by typeSlot<IFace>(), the slot is empty for interfaces not bound here
+    std::vector<sptr<AnyServiceLocator>> _typed_locators;
     mutable std::list<AnyServiceLocator::loose_binding*> _eagerBindings;
     
     sptr<ServiceLocator> _parent;
     sptr<Context> _context;
     
+    // Only set for ServiceLocators created by enterArena(), holds the ServiceLocator's reference
+    Arena* _arena;
+    
+    // Bumped each time a Scope using this ServiceLocator ends, a Lazy created before then no longer resolves
+    // from it (a pooled ServiceLocator goes on to serve another request)
+    std::atomic<uint64_t> _scopeGeneration;
+    
+    // asScoped() instances cached here, indexed by binding slot
+    slot_table<scoped_entry> _scoped;
+    
+    // Once flattened, the bindings resolveAll() visits for each interface, indexed by typeSlot<IFace>()
+    slot_table<resolve_all_view> _resolveAllViews;
+    
+    scoped_entry& scopedEntry(size_t slot, uint64_t generation) {
+        return _scoped.get(slot, [generation] (const scoped_entry& entry) {
+            return entry.generation == generation;
+        }, [generation] () {
+            auto entry = new scoped_entry();
+            entry->generation = generation;
+            return entry;
+        });
+    }
+    
+    // Every binding of IFace in this ServiceLocator and its parents, in resolveAll() order
+    template <class IFace>
+    void collectBindings(std::vector<typename TypedServiceLocator<IFace>::shared_ptr_binding*>& bindings) {
+        for(auto sl = this; sl != nullptr; sl = sl->_parent.get()) {
+            auto nsl = sl->getTypedServiceLocator<IFace>(false);
+            if (nsl != nullptr) {
+                nsl->collectBindings(bindings);
+            }
+        }
+    }
+    
+    // Only once flattened, when the bindings can no longer change
+    template <class IFace>
+    typed_resolve_all_view<IFace>& resolveAllView() {
+        return static_cast<typed_resolve_all_view<IFace>&>(_resolveAllViews.get(typeSlot<IFace>(), [] (const resolve_all_view&) {
+            return true;
+        }, [this] () {
+            auto view = new typed_resolve_all_view<IFace>();
+            collectBindings<IFace>(view->bindings);
+            return view;
+        }));
+    }
+    
+    // Once sealed the binding tables are never written again, resolving needs no locking
+    bool _sealed;
+    
+    // Set on seal() when the parent is flattened too: every typed locator visible from here (including
+    // our parents') indexed by typeSlot<IFace>().  Typed locators nobody overrides are shared with the
+    // parent, _merged owns the ones combining our bindings with our parent's for the same interface
+    sptr<const std::vector<AnyServiceLocator*>> _flattened;
+    std::vector<sptr<AnyServiceLocator>> _merged;
+    
+    // Set by freeze(), read only from then on
+    uptr<const frozen_table> _frozen;
+    
     // We store a weak_ptr to ourselves so that we can create shared_ptr's from it when we enter() child
     // locators
     wptr<ServiceLocator> _this;
     
     template <class IFace>
     TypedServiceLocator<IFace>* getTypedServiceLocator(bool createIfRequired) {
-        auto typeIndex = std::type_index(typeid(IFace));
-        auto find = _typed_locators.find(typeIndex);
-        if (find != _typed_locators.end()) {
-            return dynamic_cast<TypedServiceLocator<IFace>*>(find->second);
+        auto slot = typeSlot<IFace>();
+        if (slot < _typed_locators.size() && _typed_locators[slot] != nullptr) {
+            // Only a TypedServiceLocator<IFace> is ever stored in IFace's slot
+            return static_cast<TypedServiceLocator<IFace>*>(_typed_locators[slot].get());
         }
         
         if (!createIfRequired) {
             return nullptr;
         }
         
+        if (slot >= _typed_locators.size()) {
+            _typed_locators.resize(slot + 1);
+        }
         auto nsl = new TypedServiceLocator<IFace>();
-        _typed_locators.insert(std::pair<std::type_index, AnyServiceLocator*>(typeIndex, nsl));
+        _typed_locators[slot] = sptr<AnyServiceLocator>(nsl);
         return nsl;
     }
     
+    template <class IFace>
+    typename TypedServiceLocator<IFace>::shared_ptr_binding* findFrozen(const Name& name) const {
+        // Only a binding of IFace is ever stored under IFace's slot
+        return static_cast<typename TypedServiceLocator<IFace>::shared_ptr_binding*>(_frozen->find(typeSlot<IFace>(), name));
+    }
+    
+    template <class IFace>
+    TypedServiceLocator<IFace>* getFlattenedServiceLocator() const {
+        auto slot = typeSlot<IFace>();
+        if (slot < _flattened->size()) {
+            return static_cast<TypedServiceLocator<IFace>*>((*_flattened)[slot]);
+        }
+        return nullptr;
+    }
+    
+    void flatten() {
+        if (_parent == nullptr) {
+            auto flattened = new std::vector<AnyServiceLocator*>(_typed_locators.size());
+            for(size_t slot = 0; slot < _typed_locators.size(); slot++) {
+                (*flattened)[slot] = _typed_locators[slot].get();
+            }
+            _flattened = sptr<const std::vector<AnyServiceLocator*>>(flattened);
+            return;
+        }
+        
+        if (_parent->_flattened == nullptr) {
+            // parent may still change, we have to keep walking it
+            return;
+        }
+        
+        if (_typed_locators.empty()) {
+            _flattened = _parent->_flattened;
+            return;
+        }
+        
+        auto flattened = new std::vector<AnyServiceLocator*>(*_parent->_flattened);
+        if (flattened->size() < _typed_locators.size()) {
+            flattened->resize(_typed_locators.size());
+        }
+        for(size_t slot = 0; slot < _typed_locators.size(); slot++) {
+            auto nsl = _typed_locators[slot].get();
+            if (nsl == nullptr) {
+                continue;
+            }
+            auto parent = (*flattened)[slot];
+            if (parent == nullptr) {
+                (*flattened)[slot] = nsl;
+            } else {
+                auto merged = nsl->mergedWith(*parent);
+                _merged.push_back(merged);
+                (*flattened)[slot] = merged.get();
+            }
+        }
+        _flattened = sptr<const std::vector<AnyServiceLocator*>>(flattened);
+    }
+    
+    static const size_t ScopePoolSize = 32;
+    
+    static std::vector<sptr<ServiceLocator>>& scopePool() {
+        static thread_local std::vector<sptr<ServiceLocator>> pool;
+        return pool;
+    }
+    
+    // Called when a Scope ends, if nothing else still refers to the child we drop its bindings and keep
+    // it in this thread's pool for the next enterScope()
+    static void recycle(sptr<ServiceLocator>&& slp) {
+        slp->_scopeGeneration.fetch_add(1, std::memory_order_release);
+        slp->_module_clause.reset();
+        auto& pool = scopePool();
+        if (slp.use_count() != 1 || slp->_context.use_count() != 1 || pool.size() >= ScopePoolSize) {
+            return;
+        }
+        
+        slp->_typed_locators.clear();
+        slp->_eagerBindings.clear();
+        slp->_parent.reset();
+        if (slp->_arena != nullptr) {
+            slp->_arena->release();
+            slp->_arena = nullptr;
+        }
+        slp->_scoped.clear();
+        slp->_resolveAllViews.clear();
+        slp->_sealed = false;
+        slp->_flattened.reset();
+        slp->_frozen.reset();
+        slp->_merged.clear();
+        pool.push_back(std::move(slp));
+    }
+    
+    template <class IFace>
+    void checkNotSealed() const {
+        if (_sealed) {
+            throw BindingIssueException(std::string("ServiceLocator is sealed, cannot bind <") + typeid(IFace).name() + ">");
+        }
+    }
+    
+    template <class IFace>
+    typename TypedServiceLocator<IFace>::shared_ptr_binding* findBinding(const Name& name) {
+        for(auto sl = this; sl != nullptr; sl = sl->_parent.get()) {
+            auto nsl = sl->getTypedServiceLocator<IFace>(false);
+            auto binding = nsl != nullptr ? nsl->find(name) : nullptr;
+            if (binding != nullptr) {
+                return binding;
+            }
+        }
+        return nullptr;
+    }
+    
+    // Look up the binding IFace resolves to and compile the steps of its declared dependencies
+    template <class IFace>
+    sptr<plan_step> compileStep(const Name& name, compile_path& path) {
+        auto frame = "resolve<" + Context::getTypeName(std::type_index(typeid(IFace))) + ">(" + name.str() + ")";
+        auto binding = findBinding<IFace>(name);
+        if (binding == nullptr) {
+            throw UnableToResolveException("Unable to resolve <" + Context::getTypeName(std::type_index(typeid(IFace))) + ">  resolve path = " + path.str(frame));
+        }
+        auto compiled = path.compiled.find(binding);
+        if (compiled != path.compiled.end()) {
+            return compiled->second;
+        }
+        if (std::find(path.bindings.begin(), path.bindings.end(), binding) != path.bindings.end()) {
+            throw RecursiveResolveException("Recursive resolve path = " + path.str(frame));
+        }
+        
+        auto step = sptr<typed_plan_step<IFace>>(new typed_plan_step<IFace>(binding));
+        if (binding->getDependencies() != nullptr) {
+            path.bindings.push_back(binding);
+            path.frames.push_back(frame);
+            for(auto fnCompile = binding->getDependencies(); *fnCompile != nullptr; fnCompile++) {
+                step->_dependencies.push_back((*fnCompile)(*this, path));
+            }
+            path.bindings.pop_back();
+            path.frames.pop_back();
+        }
+        path.compiled[binding] = step;
+        return step;
+    }
+    
     // Hide default constructor - client should call ::create which returns a shared_ptr version
     ServiceLocator() : ServiceLocator(nullptr) {
     }
@@ -595,6 +2348,14 @@ private:
         _eagerBindings(),
         _parent(parent),
         _context(),
+        _arena(nullptr),
+        _scopeGeneration(0),
+        _scoped(),
+        _resolveAllViews(),
+        _sealed(false),
+        _flattened(),
+        _merged(),
+        _frozen(),
         _this(),
         _module_clause()
     {
@@ -602,20 +2363,36 @@ private:
     
     // Resolve a named interface, throws if not able to resolve
     template <class IFace>
-    sptr<IFace> _resolve(sptr<Context> slc) {
-        auto& name = slc->getName();
+    sptr<IFace> _resolve(Context& slc) {
+        if (_frozen != nullptr) {
+            auto binding = findFrozen<IFace>(slc._name);
+            if (binding == nullptr) {
+                throw UnableToResolveException(std::string("Unable to resolve <") + slc.getInterfaceTypeName() + ">  resolve path = " + slc.getResolvePath());
+            }
+            return binding->get(slc);
+        }
+        
+        if (_flattened != nullptr) {
+            auto nsl = getFlattenedServiceLocator<IFace>();
+            auto ptr = nsl != nullptr ? nsl->tryResolve(slc._name, slc) : nullptr;
+            if (ptr == nullptr) {
+                throw UnableToResolveException(std::string("Unable to resolve <") + slc.getInterfaceTypeName() + ">  resolve path = " + slc.getResolvePath());
+            }
+            return ptr;
+        }
+        
         auto nsl = getTypedServiceLocator<IFace>(false);
         if (nsl == nullptr) {
             if (_parent == nullptr) {
-                throw UnableToResolveException(std::string("Unable to resolve <") + slc->getInterfaceTypeName() + ">  resolve path = " + slc->getResolvePath());
+                throw UnableToResolveException(std::string("Unable to resolve <") + slc.getInterfaceTypeName() + ">  resolve path = " + slc.getResolvePath());
             }
             return _parent->_resolve<IFace>(slc);
         }
         
-        auto ptr = nsl->tryResolve(name, slc);
+        auto ptr = nsl->tryResolve(slc._name, slc);
         if (ptr == nullptr) {
             if (_parent == nullptr) {
-                throw UnableToResolveException(std::string("Unable to resolve <") + slc->getInterfaceTypeName() + ">  resolve path = " + slc->getResolvePath());
+                throw UnableToResolveException(std::string("Unable to resolve <") + slc.getInterfaceTypeName() + ">  resolve path = " + slc.getResolvePath());
             }
             return _parent->_resolve<IFace>(slc);
         }
@@ -623,36 +2400,47 @@ private:
         return ptr;
     }
 
-    // Resolve a named interface, throws if not able to resolve
+    // The binding a named interface resolves to (or nullptr), only looks it up, needs no Context and neither
+    // throws nor allocates
     template <class IFace>
-    void _visitAll(std::function<void(sptr<typename TypedServiceLocator<IFace>::shared_ptr_binding>)> fnVisit) {
-        auto nsl = getTypedServiceLocator<IFace>(false);
-        if (nsl != nullptr) {
-            nsl->visitAll(fnVisit);
+    typename TypedServiceLocator<IFace>::shared_ptr_binding* _findBinding(const Name& name) {
+        if (_frozen != nullptr) {
+            return findFrozen<IFace>(name);
         }
         
-        if (_parent != nullptr) {
-            _parent->_visitAll<IFace>(fnVisit);
+        if (_flattened != nullptr) {
+            auto nsl = getFlattenedServiceLocator<IFace>();
+            return nsl != nullptr ? nsl->find(name) : nullptr;
         }
-    }
-
-    template <class IFace>
-    bool _canResolve(sptr<Context> slc) {
-        auto nsl = getTypedServiceLocator<IFace>(false);
-        if (nsl == nullptr) {
-            if (_parent == nullptr) {
-                return false;
+        
+        for(auto sl = this; sl != nullptr; sl = sl->_parent.get()) {
+            auto nsl = sl->getTypedServiceLocator<IFace>(false);
+            auto binding = nsl != nullptr ? nsl->find(name) : nullptr;
+            if (binding != nullptr) {
+                return binding;
             }
-            
-            return _parent->_canResolve<IFace>(slc);
         }
-        
-        return nsl->canResolve(slc->getName());
+        return nullptr;
+    }
+    
+    template <class IFace>
+    bool _canResolve(const Name& name) {
+        return _findBinding<IFace>(name) != nullptr;
     }
     
     // Try to resolve a named interface, returns nullptr on failure
     template <class IFace>
-    sptr<IFace> _tryResolve(sptr<Context> slc) {
+    sptr<IFace> _tryResolve(Context& slc) {
+        if (_frozen != nullptr) {
+            auto binding = findFrozen<IFace>(slc._name);
+            return binding != nullptr ? binding->get(slc) : nullptr;
+        }
+        
+        if (_flattened != nullptr) {
+            auto nsl = getFlattenedServiceLocator<IFace>();
+            return nsl != nullptr ? nsl->tryResolve(slc._name, slc) : nullptr;
+        }
+        
         auto nsl = getTypedServiceLocator<IFace>(false);
         if (nsl == nullptr) {
             if (_parent == nullptr) {
@@ -662,7 +2450,7 @@ private:
             return _parent->_tryResolve<IFace>(slc);
         }
 
-        auto ptr = nsl->tryResolve(slc->getName(), slc);
+        auto ptr = nsl->tryResolve(slc._name, slc);
         if (ptr == nullptr && _parent != nullptr) {
             return _parent->_tryResolve<IFace>(slc);
         }
@@ -679,12 +2467,15 @@ public:
         // instances from a raw pointer you will crash on 2nd shared_ptr going out of scope and deleting
         // the instance which has already been deleted by the 1st shared_ptr going out of scope
         slp->_this = slp;
-        slp->_context = sptr<Context>(new Context(slp));
+        slp->_context = sptr<Context>(new Context(slp.get()));
 
         return slp;
     }
     
     virtual ~ServiceLocator() {
+        if (_arena != nullptr) {
+            _arena->release();
+        }
     }
     
     // Create a child ServiceLocator.  Children can override parent bindings or add new ones (they cannot delete
@@ -692,30 +2483,418 @@ public:
     sptr<ServiceLocator> enter() {
         auto slp = sptr<ServiceLocator>(new ServiceLocator(sptr<ServiceLocator>(_this)));
         slp->_this = slp;
-        slp->_context = sptr<Context>(new Context(slp));
+        slp->_context = sptr<Context>(new Context(slp.get()));
+        return slp;
+    }
+    
+    // Create a child ServiceLocator which places the transients resolved from it (and their shared_ptr
+    // control blocks) in an arena instead of allocating each one, use it for a request which resolves
+    // many short lived transients.  The arena is released in one go once the child and all of the
+    // transients are gone.  Only transients created by toSelf, to<>, toNoDependancy, toConstructor or
+    // Context::make() on the thread calling enterArena() are placed in the arena.  Singletons (and thread
+    // local or scoped instances) never are, nor are the transients those are constructed with
+    sptr<ServiceLocator> enterArena(size_t blockSize = 4096) {
+        auto slp = enter();
+        slp->_arena = Arena::create(blockSize);
         return slp;
     }
     
+    // A child ServiceLocator borrowed from a per thread pool by enterScope(), it is returned to the pool
+    // (with all of its bindings dropped) when the Scope is destroyed.  Use a Scope per request rather than
+    // enter() to avoid allocating and freeing a ServiceLocator and its Context for every request
+    class Scope {
+        friend class ServiceLocator;
+        
+    private:
+        Scope& operator=(const Scope&) = delete; // non copyable
+        Scope(const Scope&) = delete;            // non construction-copyable
+        
+        sptr<ServiceLocator> _sl;
+        
+        Scope(sptr<ServiceLocator>&& sl) : _sl(std::move(sl)) {
+        }
+        
+    public:
+        Scope(Scope&& scope) : _sl(std::move(scope._sl)) {
+        }
+        
+        // Recycles the child held so far, so one Scope can be reused for each request
+        Scope& operator=(Scope&& scope) {
+            if (this != &scope) {
+                if (_sl != nullptr) {
+                    recycle(std::move(_sl));
+                }
+                _sl = std::move(scope._sl);
+            }
+            return *this;
+        }
+        
+        ~Scope() {
+            if (_sl != nullptr) {
+                recycle(std::move(_sl));
+            }
+        }
+        
+        ServiceLocator* operator->() const {
+            return _sl.get();
+        }
+        
+        const sptr<ServiceLocator>& get() const {
+            return _sl;
+        }
+    };
+    
+    // Create a pooled child ServiceLocator, see Scope
+    Scope enterScope() {
+        auto& pool = scopePool();
+        if (pool.empty()) {
+            return Scope(enter());
+        }
+        
+        auto slp = std::move(pool.back());
+        pool.pop_back();
+        slp->_parent = _this.lock();
+        return Scope(std::move(slp));
+    }
+    
+    // A ServiceLocator whose bindings can be replaced (swap a backend, rotate credentials ..) whilst other
+    // threads resolve from it.  reload() binds and freezes a new version then publishes it, resolves starting
+    // after that see the new version whilst those already under way finish against the version they started
+    // with.  A replaced version, and its singletons, is released once nothing refers to it any more.  Finding
+    // the current version takes no lock, each thread keeps the version it last saw until a reload
+    class Reloadable {
+        friend class ServiceLocator;
+        
+    private:
+        Reloadable& operator=(const Reloadable&) = delete; // non copyable
+        Reloadable(const Reloadable&) = delete;            // non construction-copyable
+        
+        // Versions are children of _parent when set, its bindings (and singletons) are kept across reloads
+        sptr<ServiceLocator> _parent;
+        
+        // Serialises publishing, _current is only read or written under it
+        std::mutex _mutex;
+        sptr<ServiceLocator> _current;
+        std::atomic<uint64_t> _generation;
+        
+        size_t _slot;
+        uint64_t _slotGeneration;
+        
+        // For provider() lambdas to keep us alive
+        wptr<Reloadable> _this;
+        
+        static uint64_t nextGeneration() {
+            static std::atomic<uint64_t> generation(0);
+            return generation.fetch_add(1, std::memory_order_relaxed) + 1;
+        }
+        
+        Reloadable(sptr<ServiceLocator> parent) : _parent(parent), _mutex(), _current(), _generation(0), _this() {
+            acquireBindingSlot(_slot, _slotGeneration);
+        }
+        
+    public:
+        ~Reloadable() {
+            releaseBindingSlot(_slot);
+        }
+        
+        // Bind a new version with fnBind and publish it.  If fnBind (or an eager binding) throws the current
+        // version stays in place
+        void reload(const std::function<void(sptr<ServiceLocator>)>& fnBind) {
+            auto version = _parent != nullptr ? _parent->enter() : ServiceLocator::create();
+            fnBind(version);
+            version->freeze();
+            
+            std::unique_lock<std::mutex> lock(_mutex);
+            _current.swap(version);
+            _generation.store(nextGeneration(), std::memory_order_release);
+            lock.unlock();
+            // version is now the replaced one, released here (outside the lock) if no resolve still has it
+        }
+        
+        // The current version, hold on to it to resolve a whole request from one version
+        sptr<ServiceLocator> current() {
+            auto generation = _generation.load(std::memory_order_acquire);
+            auto& versions = reloadableVersions();
+            if (_slot < versions.size() && versions[_slot].generation == generation) {
+                auto version = versions[_slot].version.lock();
+                if (version != nullptr) {
+                    return version;
+                }
+            }
+            
+            std::unique_lock<std::mutex> lock(_mutex);
+            auto version = _current;
+            generation = _generation.load(std::memory_order_relaxed);
+            lock.unlock();
+            if (version == nullptr) {
+                throw BindingIssueException("Reloadable ServiceLocator has not been loaded");
+            }
+            if (_slot >= versions.size()) {
+                versions.resize(_slot + 1);
+            }
+            versions[_slot].generation = generation;
+            versions[_slot].version = version;
+            return version;
+        }
+        
+        // Resolve a named interface from the current version, throws if not able to resolve
+        template <class IFace>
+        sptr<IFace> resolve(const std::string& named) {
+            return current()->getContext()->template resolve<IFace>(named);
+        }
+        
+        // Resolve an interface by interned name from the current version, throws if not able to resolve
+        template <class IFace>
+        sptr<IFace> resolve(const Name& named) {
+            return current()->getContext()->template resolve<IFace>(named);
+        }
+        
+        // Resolve an interface from the current version, throws if not able to resolve
+        template <class IFace>
+        sptr<IFace> resolve() {
+            return current()->getContext()->template resolve<IFace>();
+        }
+        
+        // Unlike Context::provider() each call resolves from the version current at the time
+        template <class IFace>
+        std::function<sptr<IFace>(const std::string&)> provider() {
+            auto reloadable = _this.lock();
+            return [reloadable] (const std::string& name) {
+                return reloadable->template resolve<IFace>(name);
+            };
+        }
+    };
+    
+    // Create a Reloadable whose versions are root ServiceLocators, bound by fnBind
+    static sptr<Reloadable> createReloadable(const std::function<void(sptr<ServiceLocator>)>& fnBind) {
+        auto reloadable = sptr<Reloadable>(new Reloadable(nullptr));
+        reloadable->_this = reloadable;
+        reloadable->reload(fnBind);
+        return reloadable;
+    }
+    
+    // Create a Reloadable whose versions are children of this ServiceLocator, bound by fnBind.  This
+    // ServiceLocator is frozen, its bindings are shared by every version
+    sptr<Reloadable> enterReloadable(const std::function<void(sptr<ServiceLocator>)>& fnBind) {
+        auto reloadable = sptr<Reloadable>(new Reloadable(_this.lock()));
+        reloadable->_this = reloadable;
+        reloadable->reload(fnBind);
+        return reloadable;
+    }
+    
     // Create a named binding
     template <class IFace>
     typename TypedServiceLocator<IFace>::shared_ptr_binding::to_clause& bind(const std::string& named) {
+        checkNotSealed<IFace>();
         auto nsl = getTypedServiceLocator<IFace>(true);
         
-        return nsl->bind(named, &_eagerBindings);
+        return nsl->bind(name(named), &_eagerBindings);
     }
     
     // Create a binding
     template <class IFace>
     typename TypedServiceLocator<IFace>::shared_ptr_binding::to_clause& bind() {
+        checkNotSealed<IFace>();
         auto nsl = getTypedServiceLocator<IFace>(true);
         
-        return nsl->bind("", &_eagerBindings);
+        return nsl->bind(Context::noName(), &_eagerBindings);
+    }
+    
+    // Finish binding, eager bindings are run and any further bind<>() throws.  A sealed ServiceLocator
+    // (and its Context) can then be resolved from any number of threads concurrently without locking,
+    // singletons are constructed exactly once with other resolving threads waiting on the construction.
+    // Children created by enter() are not sealed, seal them once their own bindings are done.
+    //
+    // Sealing a child whose parent is sealed flattens the parent chain into the child, resolving from the
+    // child is then a single lookup however deep it is nested rather than a walk up its parents
+    void seal() {
+        if (_sealed) {
+            return;
+        }
+        getContext();
+        _sealed = true;
+        flatten();
+    }
+    
+    bool isSealed() const {
+        return _sealed;
+    }
+    
+    // Seal, then lay out every binding visible from here (our parents' included) in one compact read only
+    // table, resolving a frozen ServiceLocator is a single probe of that table.  Our parents are frozen
+    // first, so the bindings in the table can no longer change
+    void freeze() {
+        if (_frozen != nullptr) {
+            return;
+        }
+        if (_parent != nullptr) {
+            _parent->freeze();
+        }
+        seal();
+        
+        size_t bindings = 0;
+        for(auto sl = this; sl != nullptr; sl = sl->_parent.get()) {
+            for(auto& nsl : sl->_typed_locators) {
+                bindings += nsl != nullptr ? nsl->bindingCount() : 0;
+            }
+        }
+        auto frozen = uptr<frozen_table>(new frozen_table(bindings));
+        for(auto sl = this; sl != nullptr; sl = sl->_parent.get()) {
+            for(size_t slot = 0; slot < sl->_typed_locators.size(); slot++) {
+                if (sl->_typed_locators[slot] != nullptr) {
+                    sl->_typed_locators[slot]->freezeInto(slot, *frozen);
+                }
+            }
+        }
+        _frozen = std::move(frozen);
+    }
+    
+    bool isFrozen() const {
+        return _frozen != nullptr;
+    }
+    
+    // A precompiled resolve of IFace, see compile()
+    template <class IFace>
+    class Plan {
+        friend class ServiceLocator;
+        
+    private:
+        sptr<ServiceLocator> _sl;
+        sptr<plan_step> _step;
+        
+        Plan(sptr<ServiceLocator> sl, sptr<plan_step> step) : _sl(sl), _step(step) {
+        }
+        
+    public:
+        sptr<IFace> resolve() const {
+            Context ctx(_sl.get());
+            return static_cast<typed_plan_step<IFace>&>(*_step).run(ctx);
+        }
+    };
+    
+    // Seal and check every binding's declared (toConstructor) dependencies can be resolved, throws
+    // UnableToResolveException or RecursiveResolveException for the first one that cannot be
+    void validate() {
+        seal();
+        compile_path path;
+        for(auto sl = this; sl != nullptr; sl = sl->_parent.get()) {
+            for(auto& nsl : sl->_typed_locators) {
+                if (nsl != nullptr) {
+                    nsl->compileAll(*this, path);
+                }
+            }
+        }
+    }
+    
+    // Seal and compile a plan for resolving IFace, its toConstructor dependencies (and theirs..) are looked
+    // up once now so resolving from the plan constructs them without any lookups.  Throws as validate()
+    // does.  Bindings which are not toConstructor bindings resolve their dependencies as usual
+    template <class IFace>
+    Plan<IFace> compile(const std::string& named) {
+        seal();
+        compile_path path;
+        return Plan<IFace>(_this.lock(), compileStep<IFace>(name(named), path));
+    }
+    
+    template <class IFace>
+    Plan<IFace> compile() {
+        seal();
+        compile_path path;
+        return Plan<IFace>(_this.lock(), compileStep<IFace>(Context::noName(), path));
+    }
+    
+#ifdef SERVICELOCATOR_STATS
+    // Statistics for the bindings made in this ServiceLocator (not its parents)
+    std::vector<BindingStats> getBindingStats() const {
+        std::vector<BindingStats> stats;
+        for(auto& nsl : _typed_locators) {
+            if (nsl != nullptr) {
+                nsl->collectStats(stats);
+            }
+        }
+        return stats;
+    }
+    
+    void dumpBindingStats(std::ostream& out) const {
+        for(auto& stats : getBindingStats()) {
+            out << "bind<" << stats.interfaceType << ">(" << stats.name << ")"
+                << " resolves=" << stats.resolves
+                << " constructions=" << stats.constructions
+                << " cacheHitRate=" << stats.cacheHitRate()
+                << " totalConstructionUs=" << std::chrono::duration_cast<std::chrono::microseconds>(stats.totalConstructionTime).count()
+                << " maxConstructionUs=" << std::chrono::duration_cast<std::chrono::microseconds>(stats.maxConstructionTime).count()
+                << "\n";
+        }
+    }
+#endif
+    
+    struct EagerBindingTime {
+        std::string interfaceType;
+        std::string name;
+        // includes waiting on dependencies being constructed by other threads
+        std::chrono::nanoseconds time;
+    };
+    
+    struct EagerInitReport {
+        std::chrono::nanoseconds totalTime;
+        std::vector<EagerBindingTime> bindings;
+    };
+    
+    // Run the eager bindings on threads threads rather than one by one on the first getContext().  Any
+    // singleton being constructed by one thread that another needs is waited on, so dependencies are
+    // still constructed before their dependants, and singletons depending on each other throw a
+    // RecursiveResolveException rather than waiting forever.  The first exception thrown by a binding
+    // is rethrown once all threads are done
+    EagerInitReport eagerInit(size_t threads) {
+        std::vector<AnyServiceLocator::loose_binding*> eagerBindings(_eagerBindings.begin(), _eagerBindings.end());
+        EagerInitReport report;
+        report.bindings.resize(eagerBindings.size());
+        
+        std::atomic<size_t> next(0);
+        std::mutex exceptionMutex;
+        std::exception_ptr exception;
+        auto fnWork = [this, &eagerBindings, &report, &next, &exceptionMutex, &exception] () {
+            for(auto i = next++; i < eagerBindings.size(); i = next++) {
+                auto eagerBinding = eagerBindings[i];
+                auto start = std::chrono::steady_clock::now();
+                try {
+                    eagerBinding->eagerBind(*_context);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(exceptionMutex);
+                    if (exception == nullptr) {
+                        exception = std::current_exception();
+                    }
+                }
+                auto& time = report.bindings[i];
+                time.interfaceType = Context::getTypeName(eagerBinding->getInterfaceType());
+                time.name = eagerBinding->getName().str();
+                time.time = std::chrono::steady_clock::now() - start;
+            }
+        };
+        
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for(size_t t = 1; t < threads && t < eagerBindings.size(); t++) {
+            workers.push_back(std::thread(fnWork));
+        }
+        fnWork();
+        for(auto& worker : workers) {
+            worker.join();
+        }
+        report.totalTime = std::chrono::steady_clock::now() - start;
+        
+        // every eager binding has been run (or failed), getContext() must not run them again
+        _eagerBindings.clear();
+        if (exception != nullptr) {
+            std::rethrow_exception(exception);
+        }
+        return report;
     }
     
     sptr<Context> getContext() const {
         if (_eagerBindings.size() > 0) {
             for(auto eagerBinding : _eagerBindings) {
-                eagerBinding->eagerBind(_context);
+                eagerBinding->eagerBind(*_context);
             }
             _eagerBindings.clear();
         }
@@ -747,7 +2926,8 @@ public:
         
     public:
         virtual void load() = 0;
-        virtual ~Module();
+        virtual ~Module() {
+        }
     };
     
     
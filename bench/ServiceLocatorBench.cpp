@@ -0,0 +1,407 @@
+// ServiceLocator micro benchmarks
+//
+//   ./bench [filter]
+//
+// Runs every benchmark whose name contains filter (all of them by default) and writes one JSON object
+// per line to stdout, eg
+//
+//   {"benchmark":"resolve_singleton","threads":1,"iterations":1000000,"ns_per_op":31.2,"allocs_per_op":0}
+//
+// ns_per_op is the wall time of one operation on one thread, allocs_per_op counts every heap allocation
+// (global operator new) made during the run divided by the total number of operations
+
+#include <iostream>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+#include <new>
+#include "ServiceLocator.hpp"
+
+static std::atomic<size_t> allocationCount(0);
+
+void* operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (auto p = std::malloc(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+class IFoo {
+public:
+    virtual ~IFoo() {
+    }
+    virtual int foo() = 0;
+};
+
+class Foo : public IFoo {
+public:
+    Foo(SLContext_sptr slc) {
+    }
+
+    int foo() override {
+        return 1;
+    }
+};
+
+// Distinct interface types, used to fill a locator with many bound interfaces
+template <int N>
+class Many {
+public:
+    int many() {
+        return N;
+    }
+};
+
+template <int N>
+struct BindMany {
+    static void bind(sptr<ServiceLocator> sl) {
+        sl->bind<Many<N>>().toSelfNoDependancy().asSingleton();
+        BindMany<N - 1>::bind(sl);
+    }
+};
+
+template <>
+struct BindMany<0> {
+    static void bind(sptr<ServiceLocator> sl) {
+    }
+};
+
+// Node<N> depends on Node<N - 1>, resolving Node<N> builds a dependency graph N deep
+template <int N>
+class Node {
+public:
+    sptr<Node<N - 1>> next;
+
+    Node(sptr<Node<N - 1>> next) : next(next) {
+    }
+
+    int depth() {
+        return N;
+    }
+};
+
+template <>
+class Node<0> {
+public:
+    int depth() {
+        return 0;
+    }
+};
+
+template <int N>
+struct BindNodes {
+    static void bind(sptr<ServiceLocator> sl) {
+        sl->bind<Node<N>>().template toConstructor<Node<N>, Node<N - 1>>();
+        BindNodes<N - 1>::bind(sl);
+    }
+};
+
+template <>
+struct BindNodes<0> {
+    static void bind(sptr<ServiceLocator> sl) {
+        sl->bind<Node<0>>().toSelfNoDependancy();
+    }
+};
+
+static std::string filter;
+
+static void report(const std::string& name, size_t threads, size_t iterations, std::chrono::steady_clock::duration elapsed, size_t allocations) {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    std::cout << "{\"benchmark\":\"" << name << "\""
+        << ",\"threads\":" << threads
+        << ",\"iterations\":" << iterations
+        << ",\"ns_per_op\":" << (double)ns / iterations
+        << ",\"allocs_per_op\":" << (double)allocations / (iterations * threads)
+        << "}" << std::endl;
+}
+
+// Runs fn iterations times on each of threads threads (all starting together)
+template <class Fn>
+void measure(const std::string& name, size_t threads, size_t iterations, Fn fn) {
+    if (name.find(filter) == std::string::npos) {
+        return;
+    }
+
+    // warm up, this constructs any singletons
+    fn();
+
+    std::atomic<size_t> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<std::thread> workers;
+    for(size_t t = 1; t < threads; t++) {
+        workers.push_back(std::thread([&] () {
+            ready++;
+            while (!go) {
+                std::this_thread::yield();
+            }
+            for(size_t i = 0; i < iterations; i++) {
+                fn();
+            }
+        }));
+    }
+    while (ready != threads - 1) {
+        std::this_thread::yield();
+    }
+
+    auto allocations = allocationCount.load();
+    auto start = std::chrono::steady_clock::now();
+    go = true;
+    for(size_t i = 0; i < iterations; i++) {
+        fn();
+    }
+    for(auto& worker : workers) {
+        worker.join();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    report(name, threads, iterations, elapsed, allocationCount.load() - allocations);
+}
+
+template <class Fn>
+void measure(const std::string& name, size_t iterations, Fn fn) {
+    measure(name, 1, iterations, fn);
+}
+
+int main(int argc, const char * argv[]) {
+    if (argc > 1) {
+        filter = argv[1];
+    }
+
+    const size_t iterations = 1000000;
+
+    auto sl = ServiceLocator::create();
+    sl->bind<IFoo>("singleton").to<Foo>().asSingleton();
+    sl->bind<IFoo>("transient").to<Foo>();
+    sl->bind<Foo>().toSelf().asThreadLocal();
+    sl->bind<IFoo>().to<Foo>().asSingleton();
+    for(int i = 0; i < 300; i++) {
+        sl->bind<IFoo>("tenant" + std::to_string(i)).to<Foo>().asSingleton();
+    }
+    BindNodes<30>::bind(sl);
+    auto slc = sl->getContext();
+
+    // Basic resolves
+
+    measure("resolve_singleton", iterations, [&slc] () {
+        return slc->resolve<IFoo>()->foo();
+    });
+
+    measure("resolve_transient", iterations, [&slc] () {
+        return slc->resolve<IFoo>("transient")->foo();
+    });
+
+    std::string tenantName = "tenant150";
+    auto tenant = ServiceLocator::name(tenantName);
+
+    measure("resolve_named_string", iterations, [&slc, &tenantName] () {
+        return slc->resolve<IFoo>(tenantName)->foo();
+    });
+
+    measure("resolve_named_interned", iterations, [&slc, &tenant] () {
+        return slc->resolve<IFoo>(tenant)->foo();
+    });
+
+    measure("try_resolve_miss", iterations, [&slc] () {
+        return slc->tryResolve<IFoo>("missing") == nullptr;
+    });
+
+    measure("can_resolve_miss", iterations, [&slc] () {
+        return slc->canResolve<IFoo>("missing");
+    });
+
+    auto missing = ServiceLocator::name("missing");
+
+    measure("resolve_result_miss_interned", iterations, [&slc, &missing] () {
+        return slc->resolveResult<IFoo>(missing).ok();
+    });
+
+    measure("resolve_result_hit_named_string", iterations, [&slc, &tenantName] () {
+        return slc->resolveResult<IFoo>(tenantName).value()->foo();
+    });
+
+    measure("resolve_all_302_singletons", iterations / 100, [&slc] () {
+        std::vector<sptr<IFoo>> all;
+        slc->resolveAll<IFoo>(&all);
+        return all.size();
+    });
+
+    measure("resolve_4_singletons", iterations, [&slc] () {
+        return slc->resolve<IFoo>()->foo() + slc->resolve<IFoo>()->foo() + slc->resolve<IFoo>()->foo() + slc->resolve<IFoo>()->foo();
+    });
+
+    measure("resolve_many_4_singletons", iterations, [&slc] () {
+        auto resolved = slc->resolveMany<IFoo, IFoo, IFoo, IFoo>();
+        return std::get<0>(resolved)->foo() + std::get<1>(resolved)->foo() + std::get<2>(resolved)->foo() + std::get<3>(resolved)->foo();
+    });
+
+    auto provider = slc->provider<IFoo>();
+    auto lazy = slc->lazy<IFoo>("singleton");
+
+    measure("provider_resolve_singleton", iterations, [&provider] () {
+        return provider("singleton")->foo();
+    });
+
+    measure("lazy_get_singleton", iterations, [&lazy] () {
+        return lazy->foo();
+    });
+
+    measure("resolve_transient_graph_30_deep", iterations / 10, [&slc] () {
+        return slc->resolve<Node<30>>()->depth();
+    });
+
+    // 40 bindings of one interface, each named binding resolving the next by name
+    auto chain = ServiceLocator::create();
+    for(int i = 0; i < 40; i++) {
+        auto next = ServiceLocator::name("chain" + std::to_string(i + 1));
+        chain->bind<IFoo>("chain" + std::to_string(i)).to<Foo>([next] (SLContext_sptr slc) {
+            slc->resolve<IFoo>(next);
+            return new Foo(slc);
+        });
+    }
+    chain->bind<IFoo>("chain40").to<Foo>();
+    auto chainc = chain->getContext();
+    auto chainHead = ServiceLocator::name("chain0");
+
+    measure("resolve_transient_named_chain_40_deep", iterations / 10, [&chainc, &chainHead] () {
+        return chainc->resolve<IFoo>(chainHead)->foo();
+    });
+
+    auto nodes = ServiceLocator::create();
+    BindNodes<30>::bind(nodes);
+    auto plan = nodes->compile<Node<30>>();
+
+    measure("resolve_transient_graph_30_deep_compiled", iterations / 10, [&plan] () {
+        return plan.resolve()->depth();
+    });
+
+    auto tenants = ServiceLocator::create();
+    for(int i = 0; i < 300; i++) {
+        tenants->bind<IFoo>("tenant" + std::to_string(i)).to<Foo>().asSingleton();
+    }
+    tenants->seal();
+    auto tenantsc = tenants->getContext();
+
+    measure("resolve_all_300_singletons_sealed", iterations, [&tenantsc] () {
+        return tenantsc->resolveAll<IFoo>()->size();
+    });
+
+    auto many = ServiceLocator::create();
+    BindMany<64>::bind(many);
+    auto manyc = many->getContext();
+
+    measure("resolve_singleton_64_interfaces", iterations, [&manyc] () {
+        return manyc->resolve<Many<32>>()->many();
+    });
+
+    many->seal();
+
+    measure("resolve_singleton_64_interfaces_sealed", iterations, [&manyc] () {
+        return manyc->resolve<Many<32>>()->many();
+    });
+
+    auto frozen = ServiceLocator::create();
+    BindMany<64>::bind(frozen);
+    frozen->freeze();
+    auto frozenc = frozen->getContext();
+
+    measure("resolve_singleton_64_interfaces_frozen", iterations, [&frozenc] () {
+        return frozenc->resolve<Many<32>>()->many();
+    });
+
+    // Child locators, a 5 deep chain of request scopes is walked when unsealed and flattened when sealed
+
+    auto walked = sl->enter();
+    auto flattened = sl->enter();
+    sl->seal();
+    flattened->seal();
+    for(int depth = 1; depth < 5; depth++) {
+        walked = walked->enter();
+        flattened = flattened->enter();
+        flattened->seal();
+    }
+    auto walkedc = walked->getContext();
+    auto flattenedc = flattened->getContext();
+
+    measure("resolve_singleton_5_deep_walked", iterations, [&walkedc] () {
+        return walkedc->resolve<IFoo>()->foo();
+    });
+
+    measure("resolve_singleton_5_deep_flattened", iterations, [&flattenedc] () {
+        return flattenedc->resolve<IFoo>()->foo();
+    });
+
+    measure("try_resolve_miss_5_deep_walked", iterations, [&walkedc] () {
+        return walkedc->tryResolve<IFoo>("missing") == nullptr;
+    });
+
+    measure("try_resolve_miss_5_deep_flattened", iterations, [&flattenedc] () {
+        return flattenedc->tryResolve<IFoo>("missing") == nullptr;
+    });
+
+    measure("enter_resolve_singleton", iterations, [&sl] () {
+        auto child = sl->enter();
+        return child->getContext()->resolve<IFoo>()->foo();
+    });
+
+    measure("enter_scope_resolve_singleton", iterations, [&sl] () {
+        auto scope = sl->enterScope();
+        return scope->getContext()->resolve<IFoo>()->foo();
+    });
+
+    measure("enter_scope_bind_resolve", iterations, [&sl] () {
+        auto scope = sl->enterScope();
+        scope->bind<IFoo>().to<Foo>();
+        return scope->getContext()->resolve<IFoo>()->foo();
+    });
+
+    measure("enter_resolve_transient_graph_30_deep", iterations / 10, [&sl] () {
+        auto child = sl->enter();
+        return child->getContext()->resolve<Node<30>>()->depth();
+    });
+
+    measure("enter_arena_resolve_transient_graph_30_deep", iterations / 10, [&sl] () {
+        auto child = sl->enterArena();
+        return child->getContext()->resolve<Node<30>>()->depth();
+    });
+
+    // Binding
+
+    measure("bind_locator_10_bindings", iterations / 10, [] () {
+        auto bound = ServiceLocator::create();
+        for(int i = 0; i < 10; i++) {
+            bound->bind<IFoo>("foo" + std::to_string(i)).to<Foo>();
+        }
+        return bound;
+    });
+
+    auto reloadable = ServiceLocator::createReloadable([] (sptr<ServiceLocator> version) {
+        version->bind<IFoo>().to<Foo>().asSingleton();
+    });
+
+    // Multithreaded scaling, ideally ns_per_op stays flat as threads are added
+
+    auto maxThreads = std::max(8u, std::thread::hardware_concurrency());
+    for(size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        measure("mt_resolve_singleton", threads, iterations, [&slc] () {
+            return slc->resolve<IFoo>()->foo();
+        });
+        measure("mt_resolve_thread_local", threads, iterations, [&slc] () {
+            return slc->resolve<Foo>()->foo();
+        });
+        measure("mt_resolve_reloadable_singleton", threads, iterations, [&reloadable] () {
+            return reloadable->resolve<IFoo>()->foo();
+        });
+        measure("mt_resolve_transient", threads, iterations / 10, [&slc] () {
+            return slc->resolve<IFoo>("transient")->foo();
+        });
+    }
+
+    return 0;
+}
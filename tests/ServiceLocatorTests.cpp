@@ -1,8 +1,15 @@
 #define CATCH_CONFIG_MAIN
 #include <catch.hpp>
 
+// Built twice by the makefile, as tests (the default, no statistics) and as tests_stats with
+// SERVICELOCATOR_STATS defined so that the statistics are covered too
+
 #include <vector>
+#include <sstream>
 #include <functional>
+#include <thread>
+#include <atomic>
+#include <algorithm>
 #include "ServiceLocator.hpp"
 
 class ITest {
@@ -74,6 +81,63 @@ public:
     }
 };
 
+class TestConstructor {
+public:
+    std::shared_ptr<ITest> test;
+    std::shared_ptr<TestNoSL> noSL;
+
+    TestConstructor(std::shared_ptr<ITest> test, std::shared_ptr<TestNoSL> noSL) : test(test), noSL(noSL) {
+    }
+};
+
+class TestCycleB;
+
+class TestCycleA {
+public:
+    TestCycleA(std::shared_ptr<TestCycleB> b) {
+    }
+};
+
+class TestCycleB {
+public:
+    TestCycleB(std::shared_ptr<TestCycleA> a) {
+    }
+};
+
+static int TestAllocatorCount = 0;
+template <class T>
+class TestAllocator {
+public:
+    typedef T value_type;
+
+    TestAllocator() {
+    }
+
+    template <class U>
+    TestAllocator(const TestAllocator<U>&) {
+    }
+
+    T* allocate(size_t n) {
+        TestAllocatorCount++;
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* p, size_t n) {
+        TestAllocatorCount--;
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    template <class U>
+    bool operator==(const TestAllocator<U>&) const {
+        return true;
+    }
+
+    template <class U>
+    bool operator!=(const TestAllocator<U>&) const {
+        return false;
+    }
+};
+
 static int TestEagerCount = 0;
 class TestEager {
 public:
@@ -82,6 +146,44 @@ public:
     }
 };
 
+static std::atomic<int> TestSlowConstructCount(0);
+static std::atomic<int> TestSlowConstructActive(0);
+static std::atomic<int> TestSlowConstructMaxActive(0);
+// When set a constructor waits (for up to a second) until two are being constructed at once
+static std::atomic<bool> TestSlowConstructRendezvous(false);
+class TestSlowConstruct {
+public:
+    TestSlowConstruct() {
+        TestSlowConstructCount++;
+        auto active = ++TestSlowConstructActive;
+        auto max = TestSlowConstructMaxActive.load();
+        while (active > max && !TestSlowConstructMaxActive.compare_exchange_weak(max, active)) {
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (TestSlowConstructRendezvous && TestSlowConstructMaxActive < 2 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+        TestSlowConstructActive--;
+    }
+};
+
+class TestLazy {
+public:
+    ServiceLocator::Lazy<TestSlowConstruct> slow;
+
+    TestLazy(ServiceLocator::Lazy<TestSlowConstruct> slow) : slow(slow) {
+    }
+};
+
+class TestLazyCycle {
+public:
+    ServiceLocator::Lazy<TestLazyCycle> self;
+
+    TestLazyCycle(ServiceLocator::Lazy<TestLazyCycle> self) : self(self) {
+    }
+};
+
 
 class TestAModule : public ServiceLocator::Module {
 public:
@@ -140,6 +242,11 @@ TEST_CASE( "ServiceLocator", "[servicelocator]" ) {
             // a is out of scope and SL should have a shared_ptr to the instance so it should not destruct
             
             REQUIRE(destructCount == 0);
+            
+            // until the SL is destroyed
+            slc.reset();
+            sl.reset();
+            REQUIRE(destructCount == 1);
         }
 
         SECTION("Basic type binding as Singleton") {
@@ -175,6 +282,333 @@ TEST_CASE( "ServiceLocator", "[servicelocator]" ) {
             REQUIRE(a1 != a2);
         }
         
+        SECTION("Resolving an unbound binding throws") {
+            // bound, but never given anything to resolve to
+            sl->bind<ITest>();
+            auto slc = sl->getContext();
+
+            REQUIRE(slc->canResolve<ITest>());
+            REQUIRE_THROWS_AS(slc->resolve<ITest>(), BindingIssueException);
+        }
+
+        SECTION("Binding to constructor") {
+            sl->bind<ITest>().to<TestA>().asSingleton();
+            sl->bind<TestNoSL>().toSelfNoDependancy();
+            sl->bind<TestConstructor>().toConstructor<TestConstructor, ITest, TestNoSL>();
+            auto slc = sl->getContext();
+
+            auto c = slc->resolve<TestConstructor>();
+
+            REQUIRE(c->test == slc->resolve<ITest>());
+            REQUIRE(c->test->contextPath == "ITest->TestConstructor->");
+            REQUIRE(c->noSL != nullptr);
+        }
+
+        SECTION("Binding to constructor with missing dependency throws") {
+            sl->bind<TestConstructor>().toConstructor<TestConstructor, ITest, TestNoSL>();
+            auto slc = sl->getContext();
+
+            REQUIRE_THROWS_AS(slc->resolve<TestConstructor>(), UnableToResolveException);
+        }
+
+        SECTION("Compiled resolve plan") {
+            sl->bind<ITest>().to<TestA>();
+            sl->bind<TestNoSL>().toSelfNoDependancy().asSingleton();
+            sl->bind<TestConstructor>().toConstructor<TestConstructor, ITest, TestNoSL>();
+
+            auto plan = sl->compile<TestConstructor>();
+            REQUIRE(sl->isSealed());
+
+            auto a = plan.resolve();
+            auto b = plan.resolve();
+            REQUIRE(a != b);
+            REQUIRE(a->test->getIt() == "TestA");
+            REQUIRE(a->test->contextPath == "ITest->TestConstructor->");
+            REQUIRE(a->noSL == b->noSL);
+            REQUIRE(a->noSL == sl->getContext()->resolve<TestNoSL>());
+        }
+
+        SECTION("Compiled resolve plan reports a recursive resolve as resolve does") {
+            sl->bind<ITest>().to<TestA>([] (SLContext_sptr slc) { slc->resolve<TestC>(); return new TestA(slc); });
+            sl->bind<TestC>().toSelf();
+
+            std::string resolveMessage;
+            try {
+                sl->getContext()->resolve<ITest>();
+            } catch (RecursiveResolveException& e) {
+                resolveMessage = e.getMessage();
+            }
+            std::string planMessage;
+            try {
+                sl->compile<ITest>().resolve();
+            } catch (RecursiveResolveException& e) {
+                planMessage = e.getMessage();
+            }
+            REQUIRE(resolveMessage == "Recursive resolve path = resolve<ITest>().to<TestA> -> resolve<TestC>().to<TestC> -> resolve<ITest>()");
+            REQUIRE(planMessage == resolveMessage);
+        }
+
+        SECTION("Validating a missing dependency throws") {
+            sl->bind<ITest>().to<TestA>();
+            sl->bind<TestConstructor>().toConstructor<TestConstructor, ITest, TestNoSL>();
+
+            std::string message;
+            try {
+                sl->validate();
+            } catch (UnableToResolveException& e) {
+                message = e.getMessage();
+            }
+            REQUIRE(message == "Unable to resolve <TestNoSL>  resolve path = resolve<TestConstructor>() -> resolve<TestNoSL>()");
+        }
+
+        SECTION("Validating recursive dependencies throws") {
+            sl->bind<TestCycleA>().toConstructor<TestCycleA, TestCycleB>();
+            sl->bind<TestCycleB>().toConstructor<TestCycleB, TestCycleA>();
+
+            REQUIRE_THROWS_AS(sl->validate(), RecursiveResolveException);
+            REQUIRE_THROWS_AS(sl->compile<TestCycleB>(), RecursiveResolveException);
+        }
+
+        SECTION("Binding to allocated implementation") {
+            TestAllocatorCount = 0;
+            sl->bind<ITest>().toAllocated<TestA>(TestAllocator<TestA>());
+            auto slc = sl->getContext();
+
+            auto a = slc->resolve<ITest>();
+            auto b = slc->resolve<ITest>();
+            REQUIRE(a != b);
+            REQUIRE(a->getIt() == "TestA");
+            // one allocation each for the instance and its control block
+            REQUIRE(TestAllocatorCount == 2);
+
+            a.reset();
+            b.reset();
+            REQUIRE(TestAllocatorCount == 0);
+        }
+
+        SECTION("Basic type binding as thread local") {
+            sl->bind<ITest>().to<TestA>().asThreadLocal();
+            auto slc = sl->getContext();
+
+            auto a = slc->resolve<ITest>();
+            REQUIRE(a == slc->resolve<ITest>());
+
+            std::shared_ptr<ITest> b;
+            std::shared_ptr<ITest> c;
+            std::thread thread([&slc, &b, &c] () {
+                b = slc->resolve<ITest>();
+                c = slc->resolve<ITest>();
+            });
+            thread.join();
+            REQUIRE(b == c);
+            REQUIRE(a != b);
+            REQUIRE(b->getIt() == "TestA");
+
+            // a new binding reusing the thread slot of a destroyed one gets its own instance
+            auto other = ServiceLocator::create();
+            other->bind<ITest>().to<TestB>().asThreadLocal();
+            REQUIRE(other->getContext()->resolve<ITest>()->getIt() == "TestB");
+            other.reset();
+            auto reused = ServiceLocator::create();
+            reused->bind<ITest>().to<TestA>().asThreadLocal();
+            REQUIRE(reused->getContext()->resolve<ITest>()->getIt() == "TestA");
+        }
+
+        SECTION("Thread local instances are destroyed with their binding") {
+            sl->bind<TransientDestructor>().toSelf().asThreadLocal();
+            auto slc = sl->getContext();
+
+            int destructCount = 0;
+            slc->resolve<TransientDestructor>()->destructCount = &destructCount;
+            std::thread thread([&slc, &destructCount] () {
+                slc->resolve<TransientDestructor>()->destructCount = &destructCount;
+            });
+            thread.join();
+            // the other thread's instance went with the thread
+            REQUIRE(destructCount == 1);
+
+            // this thread's instance goes with the ServiceLocator
+            slc.reset();
+            sl.reset();
+            REQUIRE(destructCount == 2);
+        }
+
+        SECTION("Basic type binding as scoped") {
+            sl->bind<ITest>().to<TestA>().asScoped();
+            sl->bind<TestC>().toSelf();
+
+            auto child1 = sl->enter();
+            auto child2 = sl->enter();
+            auto a = child1->getContext()->resolve<ITest>();
+            REQUIRE(a == child1->getContext()->resolve<ITest>());
+            REQUIRE(a == child1->getContext()->resolve<TestC>()->test);
+            REQUIRE(a != child2->getContext()->resolve<ITest>());
+            REQUIRE(a != sl->getContext()->resolve<ITest>());
+
+            // released with the scope
+            std::weak_ptr<ITest> weak = a;
+            a.reset();
+            REQUIRE_FALSE(weak.expired());
+            child1.reset();
+            REQUIRE(weak.expired());
+
+            {
+                auto scope = sl->enterScope();
+                weak = scope->getContext()->resolve<ITest>();
+                REQUIRE_FALSE(weak.expired());
+            }
+            REQUIRE(weak.expired());
+            auto scope = sl->enterScope();
+            REQUIRE(scope->getContext()->resolve<ITest>() != nullptr);
+        }
+
+        SECTION("Lazy dependency") {
+            TestSlowConstructCount = 0;
+            sl->bind<TestSlowConstruct>().toSelfNoDependancy();
+            sl->bind<TestLazy>().toConstructor<TestLazy, ServiceLocator::Lazy<TestSlowConstruct>>();
+            auto slc = sl->getContext();
+
+            auto lazy = slc->resolve<TestLazy>();
+            REQUIRE(TestSlowConstructCount == 0);
+
+            std::vector<std::shared_ptr<TestSlowConstruct>> resolved(4);
+            std::vector<std::thread> threads;
+            for(size_t i = 0; i < resolved.size(); i++) {
+                threads.push_back(std::thread([&lazy, &resolved, i] () {
+                    resolved[i] = lazy->slow.get();
+                }));
+            }
+            for(auto& thread : threads) {
+                thread.join();
+            }
+            REQUIRE(TestSlowConstructCount == 1);
+            for(auto& r : resolved) {
+                REQUIRE(r == resolved[0]);
+            }
+
+            // a transient, each Lazy resolves its own instance
+            slc->resolve<TestLazy>()->slow.get();
+            REQUIRE(TestSlowConstructCount == 2);
+
+            auto named = slc->lazy<TestSlowConstruct>("missing");
+            REQUIRE_THROWS_AS(named.get(), UnableToResolveException);
+        }
+
+        SECTION("Lazy dependency breaks a recursive dependency") {
+            // transient, a singleton holding a resolved Lazy of itself would own itself
+            sl->bind<TestLazyCycle>().toConstructor<TestLazyCycle, ServiceLocator::Lazy<TestLazyCycle>>();
+            sl->validate();
+
+            auto cycle = sl->getContext()->resolve<TestLazyCycle>();
+            REQUIRE(cycle->self.get() != nullptr);
+            REQUIRE(cycle->self.get() != cycle);
+        }
+
+        SECTION("Lazy does not resolve from a pooled scope after its scope ends") {
+            sl->bind<TestLazy>().toConstructor<TestLazy, ServiceLocator::Lazy<TestSlowConstruct>>();
+
+            std::shared_ptr<TestLazy> lazy;
+            ServiceLocator* pooled;
+            {
+                auto scope = sl->enterScope();
+                pooled = scope.get().get();
+                scope->bind<TestSlowConstruct>().toSelfNoDependancy();
+                lazy = scope->getContext()->resolve<TestLazy>();
+            }
+            // the next request gets the same pooled ServiceLocator, with its own bindings
+            auto next = sl->enterScope();
+            REQUIRE(next.get().get() == pooled);
+            next->bind<TestSlowConstruct>().toSelfNoDependancy();
+            REQUIRE_THROWS_AS(lazy->slow.get(), UnableToResolveException);
+        }
+
+        SECTION("Resolve many") {
+            sl->bind<ITest>().to<TestA>();
+            sl->bind<TestNoSL>().toSelfNoDependancy().asSingleton();
+            sl->bind<TestConstructor>().to<TestConstructor>([] (SLContext_sptr slc) {
+                auto resolved = slc->resolveMany<ITest, TestNoSL>();
+                return new TestConstructor(std::get<0>(resolved), std::get<1>(resolved));
+            });
+            auto slc = sl->getContext();
+
+            std::shared_ptr<ITest> test;
+            std::shared_ptr<TestConstructor> constructor;
+            std::tie(test, constructor) = slc->resolveMany<ITest, TestConstructor>();
+            REQUIRE(test->getIt() == "TestA");
+            REQUIRE(test->contextPath == "ITest->");
+            REQUIRE(constructor->test != test);
+            REQUIRE(constructor->test->contextPath == "ITest->TestConstructor->");
+            REQUIRE(constructor->noSL == slc->resolve<TestNoSL>());
+
+            REQUIRE_THROWS_AS((slc->resolveMany<ITest, TestC>()), UnableToResolveException);
+        }
+
+        SECTION("Resolve many recursive resolve throws") {
+            sl->bind<TestNoSL>().toSelfNoDependancy();
+            sl->bind<ITest>().to<TestA>([] (SLContext_sptr slc) {
+                slc->resolveMany<TestNoSL, ITest>();
+                return new TestA(slc);
+            });
+
+            REQUIRE_THROWS_AS(sl->getContext()->resolve<ITest>(), RecursiveResolveException);
+        }
+
+        SECTION("Resolve async") {
+            TestSlowConstructCount = 0;
+            sl->bind<TestSlowConstruct>("slow1").toSelfNoDependancy().asSingleton();
+            sl->bind<TestSlowConstruct>("slow2").toSelfNoDependancy().asSingleton();
+            sl->bind<ITest>().to<TestA>().asSingleton();
+            auto slc = sl->getContext();
+
+            auto slow1 = slc->resolveAsync<TestSlowConstruct>("slow1");
+            auto slow2 = slc->resolveAsync<TestSlowConstruct>(std::string("slow2"));
+            REQUIRE(slow1.get() == slc->resolve<TestSlowConstruct>("slow1"));
+            REQUIRE(slow2.get() == slc->resolve<TestSlowConstruct>("slow2"));
+            REQUIRE(TestSlowConstructCount == 2);
+
+            // constructed singletons are ready straight away
+            auto a = slc->resolve<ITest>();
+            auto ready = slc->resolveAsync<ITest>();
+            REQUIRE(ready.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+            REQUIRE(ready.get() == a);
+
+            auto missing = slc->resolveAsync<TestC>();
+            REQUIRE_THROWS_AS(missing.get(), UnableToResolveException);
+        }
+
+        SECTION("Resolve async of a dependant whilst constructing throws") {
+            // the singleton waits on an asynchronous resolve of something which depends on it
+            sl->bind<TestNoSL>().to<TestNoSL>([] (SLContext_sptr slc) {
+                slc->resolveAsync<ITest>().get();
+                return new TestNoSL();
+            }).asSingleton();
+            sl->bind<ITest>().to<TestA>([] (SLContext_sptr slc) {
+                slc->resolve<TestNoSL>();
+                return new TestA(slc);
+            });
+            auto slc = sl->getContext();
+
+            REQUIRE_THROWS_AS(slc->resolve<TestNoSL>(), RecursiveResolveException);
+        }
+
+        SECTION("Binding to async factory") {
+            sl->bind<ITest>().to<TestA>();
+            sl->bind<TestNoSL>().toSelfNoDependancy().asSingleton();
+            sl->bind<TestConstructor>().toAsync<TestConstructor>([] (SLContext_sptr slc) {
+                auto test = slc->resolveAsync<ITest>();
+                auto noSL = slc->resolveAsync<TestNoSL>();
+                return std::async(std::launch::async, [] (std::future<std::shared_ptr<ITest>> test, std::future<std::shared_ptr<TestNoSL>> noSL) {
+                    return std::make_shared<TestConstructor>(test.get(), noSL.get());
+                }, std::move(test), std::move(noSL));
+            }).asSingleton();
+            auto slc = sl->getContext();
+
+            auto constructor = slc->resolve<TestConstructor>();
+            REQUIRE(constructor->test->getIt() == "TestA");
+            REQUIRE(constructor->noSL == slc->resolve<TestNoSL>());
+            REQUIRE(slc->resolveAsync<TestConstructor>().get() == constructor);
+        }
+
         SECTION("Binding to implementation, tryResolve to null") {
             sl->bind<TestC>().toSelf();
             auto slc = sl->getContext();
@@ -233,6 +667,71 @@ TEST_CASE( "ServiceLocator", "[servicelocator]" ) {
             REQUIRE(y->getIt() == "TestB");
         }
 
+        SECTION("Resolve by interned name") {
+            for(int i = 0; i < 300; i++) {
+                sl->bind<ITest>("tenant" + std::to_string(i)).to<TestA>().asSingleton();
+            }
+            sl->bind<ITest>("B").to<TestB>();
+            auto slc = sl->getContext();
+
+            auto tenant = ServiceLocator::name("tenant123");
+            auto a = slc->resolve<ITest>(tenant);
+
+            REQUIRE(a->getIt() == "TestA");
+            REQUIRE(a == slc->resolve<ITest>("tenant123"));
+            REQUIRE(slc->canResolve<ITest>(ServiceLocator::name("B")));
+            REQUIRE(slc->tryResolve<ITest>(ServiceLocator::name("B"))->getIt() == "TestB");
+            REQUIRE(slc->tryResolve<ITest>(ServiceLocator::name("tenant300")) == nullptr);
+            REQUIRE_FALSE(slc->canResolve<TestC>(tenant));
+        }
+
+        SECTION("Resolve result") {
+            sl->bind<ITest>().to<TestA>().asSingleton();
+            sl->bind<TestC>().toSelf();
+            sl->bind<TestConstructor>().toConstructor<TestConstructor, ITest, TestNoSL>();
+            auto child = sl->enter();
+            child->bind<ITest>("B").to<TestB>();
+            auto slc = child->getContext();
+
+            auto a = slc->resolveResult<ITest>();
+            REQUIRE(a);
+            REQUIRE(a.error() == ServiceLocator::ResolveError::None);
+            REQUIRE(a.value() == slc->resolve<ITest>());
+            REQUIRE(a.getMessage() == "");
+            REQUIRE(slc->canResolve<ITest>());
+            REQUIRE(slc->resolveResult<ITest>("B").value()->getIt() == "TestB");
+
+            auto missing = slc->resolveResult<ITest>(ServiceLocator::name("missing"));
+            REQUIRE_FALSE(missing);
+            REQUIRE(missing.error() == ServiceLocator::ResolveError::Unbound);
+            REQUIRE(missing.value() == nullptr);
+            REQUIRE(missing.getMessage() == "Unable to resolve <ITest>  resolve path = resolve<ITest>(missing)");
+            REQUIRE_FALSE(slc->canResolve<ITest>("missing"));
+
+            // a name given as a std::string is not interned, a failed result keeps its own copy
+            {
+                std::string named("unknown");
+                missing = slc->resolveResult<ITest>(named);
+            }
+            REQUIRE(missing.error() == ServiceLocator::ResolveError::Unbound);
+            REQUIRE(missing.getMessage() == "Unable to resolve <ITest>  resolve path = resolve<ITest>(unknown)");
+
+            // bound, but its dependency is not
+            auto failed = slc->resolveResult<TestConstructor>();
+            REQUIRE(failed.error() == ServiceLocator::ResolveError::Failed);
+            REQUIRE(failed.getMessage() == "Unable to resolve <TestNoSL>  resolve path = resolve<TestConstructor>().to<TestConstructor> -> resolve<TestNoSL>()");
+        }
+
+        SECTION("Resolve result of a recursive resolve") {
+            sl->bind<ITest>().to<TestA>([] (SLContext_sptr slc) { slc->resolve<TestC>(); return new TestA(slc); });
+            sl->bind<TestC>().toSelf();
+            auto slc = sl->getContext();
+
+            auto result = slc->resolveResult<ITest>();
+            REQUIRE(result.error() == ServiceLocator::ResolveError::Recursive);
+            REQUIRE(result.getMessage() == "Recursive resolve path = resolve<ITest>().to<TestA> -> resolve<TestC>().to<TestC> -> resolve<ITest>()");
+        }
+
         SECTION("Binding to transient function") {
             sl->bind<ITest>().to<TestA>([] (SLContext_sptr slc) { return new TestA(slc); }).asTransient();
             auto slc = sl->getContext();
@@ -248,6 +747,56 @@ TEST_CASE( "ServiceLocator", "[servicelocator]" ) {
             REQUIRE(a->contextPath == "ITest->");
         }
         
+        SECTION("Recursive resolve throws") {
+            sl->bind<ITest>().to<TestA>([] (SLContext_sptr slc) { slc->resolve<TestC>(); return new TestA(slc); });
+            sl->bind<TestC>().toSelf();
+            auto slc = sl->getContext();
+
+            std::string message;
+            try {
+                slc->resolve<ITest>();
+            } catch (RecursiveResolveException& e) {
+                message = e.getMessage();
+            }
+            REQUIRE(message == "Recursive resolve path = resolve<ITest>().to<TestA> -> resolve<TestC>().to<TestC> -> resolve<ITest>()");
+        }
+
+        SECTION("Deep resolve which is not recursive") {
+            // more frames than the in progress filter has bits, so some share a bit without being recursive
+            for(int i = 0; i < 100; i++) {
+                auto next = "chain" + std::to_string(i + 1);
+                sl->bind<ITest>("chain" + std::to_string(i)).to<TestB>([next] (SLContext_sptr slc) { slc->resolve<ITest>(next); return new TestB(slc); });
+            }
+            sl->bind<ITest>("chain100").to<TestA>();
+            auto slc = sl->getContext();
+
+            REQUIRE(slc->resolve<ITest>("chain0")->getIt() == "TestB");
+            REQUIRE(slc->resolve<ITest>("chain99")->getIt() == "TestB");
+        }
+
+        SECTION("Deep unable to resolve path") {
+            for(int i = 0; i < 100; i++) {
+                auto next = "chain" + std::to_string(i + 1);
+                sl->bind<ITest>("chain" + std::to_string(i)).to<TestB>([next] (SLContext_sptr slc) { slc->resolve<ITest>(next); return new TestB(slc); });
+            }
+            auto slc = sl->getContext();
+
+            std::string message;
+            try {
+                slc->resolve<ITest>("chain0");
+            } catch (UnableToResolveException& e) {
+                message = e.getMessage();
+            }
+            REQUIRE(message.find("resolve path = resolve<ITest>(chain0).to<TestB> -> resolve<ITest>(chain1).to<TestB> -> ") != std::string::npos);
+            std::string tail = "resolve<ITest>(chain99).to<TestB> -> resolve<ITest>(chain100)";
+            REQUIRE(message.size() >= tail.size());
+            REQUIRE(message.compare(message.size() - tail.size(), tail.size(), tail) == 0);
+
+            // demangled once, every Context shares the name
+            ServiceLocator::Context ctx(sl.get());
+            REQUIRE(&ctx.getConcreteTypeName() == &ServiceLocator::Context(sl.get()).getConcreteTypeName());
+        }
+
         SECTION("Binding to singleton function") {
             sl->bind<ITest>().to<TestA>([] (SLContext_sptr slc) { return new TestA(slc); }).asSingleton();
             auto slc = sl->getContext();
@@ -281,6 +830,220 @@ TEST_CASE( "ServiceLocator", "[servicelocator]" ) {
             REQUIRE(b->contextPath == "ITest->");
         }
         
+        SECTION("Sealed nested locators flatten their parents") {
+            sl->bind<ITest>().to<TestA>().asSingleton();
+            sl->bind<ITest>("X").to<TestA>();
+            sl->bind<TestNoSL>().toSelfNoDependancy();
+            sl->seal();
+
+            auto leaf = sl;
+            for(int depth = 0; depth < 5; depth++) {
+                leaf = leaf->enter();
+                if (depth == 2) {
+                    leaf->bind<ITest>("Y").to<TestB>();
+                    leaf->bind<ITest>("X").to<TestB>();
+                }
+                leaf->seal();
+            }
+            auto slc = leaf->getContext();
+
+            REQUIRE(slc->resolve<ITest>() == sl->getContext()->resolve<ITest>());
+            REQUIRE(slc->resolve<ITest>("X")->getIt() == "TestB");
+            REQUIRE(slc->resolve<ITest>("Y")->getIt() == "TestB");
+            REQUIRE(slc->canResolve<TestNoSL>());
+            REQUIRE(slc->tryResolve<TestC>() == nullptr);
+            REQUIRE_THROWS_AS(slc->resolve<ITest>("Z"), UnableToResolveException);
+            REQUIRE(sl->getContext()->resolve<ITest>("X")->getIt() == "TestA");
+        }
+
+        SECTION("Frozen locators resolve from one table") {
+            sl->bind<ITest>().to<TestA>().asSingleton();
+            sl->bind<ITest>("X").to<TestA>();
+            sl->bind<TestNoSL>().toSelfNoDependancy();
+            auto child = sl->enter();
+            child->bind<ITest>("X").to<TestB>();
+            child->bind<ITest>("Y").to<TestB>();
+            child->bind<TestC>().toSelf();
+            child->freeze();
+
+            REQUIRE(child->isFrozen());
+            REQUIRE(sl->isFrozen());
+            REQUIRE_THROWS_AS((child->bind<TestNoSL>("other").toSelfNoDependancy()), BindingIssueException);
+            REQUIRE_THROWS_AS((sl->bind<TestNoSL>("other").toSelfNoDependancy()), BindingIssueException);
+
+            auto slc = child->getContext();
+            REQUIRE(slc->resolve<ITest>() == sl->getContext()->resolve<ITest>());
+            REQUIRE(slc->resolve<ITest>("X")->getIt() == "TestB");
+            REQUIRE(slc->resolve<ITest>(std::string("Y"))->getIt() == "TestB");
+            REQUIRE(slc->resolve<TestC>()->test == slc->resolve<ITest>());
+            REQUIRE(slc->canResolve<TestNoSL>());
+            REQUIRE_FALSE(slc->canResolve<TestNoSL>("X"));
+            REQUIRE(slc->tryResolve<ITest>("Z") == nullptr);
+            REQUIRE_THROWS_AS(slc->resolve<ITest>("Z"), UnableToResolveException);
+            REQUIRE(sl->getContext()->resolve<ITest>("X")->getIt() == "TestA");
+
+            // children of a frozen locator can still bind, and resolve the rest from its table
+            auto leaf = child->enter();
+            leaf->bind<ITest>("Z").to<TestA>();
+            REQUIRE(leaf->getContext()->resolve<ITest>("Z")->getIt() == "TestA");
+            REQUIRE(leaf->getContext()->resolve<ITest>("Y")->getIt() == "TestB");
+        }
+
+        SECTION("Reloading bindings") {
+            sl->bind<TestNoSL>().toSelfNoDependancy().asSingleton();
+            auto reloadable = sl->enterReloadable([] (std::shared_ptr<ServiceLocator> version) {
+                version->bind<ITest>().to<TestA>().asSingleton();
+            });
+            REQUIRE(sl->isFrozen());
+            auto provider = reloadable->provider<ITest>();
+            auto noSL = reloadable->resolve<TestNoSL>();
+
+            auto inFlight = reloadable->current();
+            std::weak_ptr<ITest> replaced = reloadable->resolve<ITest>();
+            REQUIRE(provider("")->getIt() == "TestA");
+
+            reloadable->reload([] (std::shared_ptr<ServiceLocator> version) {
+                version->bind<ITest>().to<TestB>().asSingleton();
+            });
+            REQUIRE(reloadable->resolve<ITest>()->getIt() == "TestB");
+            REQUIRE(provider("")->getIt() == "TestB");
+            REQUIRE(reloadable->resolve<TestNoSL>() == noSL);
+
+            // the version in flight still resolves its own singleton, until it is let go of
+            REQUIRE(inFlight->getContext()->resolve<ITest>() == replaced.lock());
+            inFlight.reset();
+            REQUIRE(replaced.expired());
+
+            // a failed reload leaves the current version in place
+            REQUIRE_THROWS_AS(reloadable->reload([] (std::shared_ptr<ServiceLocator> version) {
+                version->bind<ITest>().to<TestA>();
+                version->bind<ITest>().to<TestA>();
+            }), DuplicateBindingException);
+            REQUIRE(reloadable->resolve<ITest>()->getIt() == "TestB");
+        }
+
+        SECTION("Reloading whilst resolving") {
+            auto reloadable = ServiceLocator::createReloadable([] (std::shared_ptr<ServiceLocator> version) {
+                version->bind<ITest>().to<TestA>().asSingleton();
+            });
+
+            std::atomic<bool> done(false);
+            std::atomic<int> failures(0);
+            std::vector<std::thread> threads;
+            for(int t = 0; t < 4; t++) {
+                threads.push_back(std::thread([&] () {
+                    while (!done) {
+                        auto it = reloadable->resolve<ITest>()->getIt();
+                        if (it != "TestA" && it != "TestB") {
+                            failures++;
+                        }
+                    }
+                }));
+            }
+            for(int i = 0; i < 100; i++) {
+                reloadable->reload([i] (std::shared_ptr<ServiceLocator> version) {
+                    if (i % 2 == 0) {
+                        version->bind<ITest>().to<TestB>().asSingleton();
+                    } else {
+                        version->bind<ITest>().to<TestA>().asSingleton();
+                    }
+                });
+            }
+            done = true;
+            for(auto& thread : threads) {
+                thread.join();
+            }
+
+            REQUIRE(failures == 0);
+            REQUIRE(reloadable->resolve<ITest>()->getIt() == "TestA");
+        }
+
+        SECTION("Pooled scopes") {
+            sl->bind<ITest>().to<TestA>();
+            sl->bind<TestC>().toSelf();
+
+            ServiceLocator* recycled;
+            {
+                auto scope = sl->enterScope();
+                scope->bind<ITest>().to<TestB>();
+                REQUIRE(scope->getContext()->resolve<TestC>()->test->getIt() == "TestB");
+                recycled = scope.get().get();
+            }
+            {
+                // same thread gets the same child back, without the old scope's bindings
+                auto scope = sl->enterScope();
+                REQUIRE(scope.get().get() == recycled);
+                REQUIRE(scope->getContext()->resolve<ITest>()->getIt() == "TestA");
+            }
+
+            sptr<ServiceLocator> kept;
+            {
+                auto scope = sl->enterScope();
+                kept = scope.get();
+            }
+            // still referenced, so it was not recycled
+            auto scope = sl->enterScope();
+            REQUIRE(scope.get() != kept);
+            REQUIRE(kept->getContext()->resolve<ITest>()->getIt() == "TestA");
+
+            // a Scope can be reassigned, the child it held is recycled
+            auto reused = sl->enterScope();
+            auto first = reused.get().get();
+            reused->bind<ITest>().to<TestB>();
+            reused = sl->enterScope();
+            REQUIRE(reused.get().get() != first);
+            reused = sl->enterScope();
+            REQUIRE(reused.get().get() == first);
+            REQUIRE(reused->getContext()->resolve<ITest>()->getIt() == "TestA");
+        }
+
+        SECTION("Arena scope") {
+            sl->bind<ITest>().to<TestA>();
+            sl->bind<TestNoSL>().toSelfNoDependancy().asSingleton();
+            sl->bind<TestConstructor>().toConstructor<TestConstructor, ITest, TestNoSL>();
+            auto singleton = sl->getContext()->resolve<TestNoSL>();
+
+            auto arena = sl->enterArena(256);
+            auto a = arena->getContext()->resolve<TestConstructor>();
+            auto b = arena->getContext()->resolve<TestConstructor>();
+            REQUIRE(a != b);
+            REQUIRE(a->test != b->test);
+            REQUIRE(a->noSL == singleton);
+            // transients are bump allocated next to each other
+            REQUIRE(std::abs((char*)a->test.get() - (char*)b->test.get()) < 256);
+
+            // instances keep the arena alive after the scope ends
+            arena.reset();
+            REQUIRE(a->test->getIt() == "TestA");
+            REQUIRE(b->test->contextPath == "ITest->TestConstructor->");
+        }
+
+        SECTION("Arena scope only places instances it owns in the arena") {
+            sl->bind<ITest>().to<TestA>();
+            sl->bind<TestC>().toSelf().asSingleton();
+            auto arena = sl->enterArena(4096);
+            auto slc = arena->getContext();
+
+            // the first transient is placed at the start of the (live, so not shared with any other allocation) block
+            auto first = slc->resolve<ITest>();
+            auto inArena = [&first] (void* p) {
+                auto offset = (char*)p - (char*)first.get();
+                return offset >= 0 && offset < 4000;
+            };
+            REQUIRE(inArena(slc->resolve<ITest>().get()));
+
+            // a singleton first resolved from the arena scope would otherwise keep the arena alive
+            auto c = slc->resolve<TestC>();
+            REQUIRE_FALSE(inArena(c->test.get()));
+
+            // only the thread which entered the arena scope allocates from it
+            std::shared_ptr<ITest> other;
+            std::thread([&slc, &other] () {
+                other = slc->resolve<ITest>();
+            }).join();
+            REQUIRE_FALSE(inArena(other.get()));
+        }
+
         SECTION("Module loading") {
             sl->modules().add<TestAModule>().add<TestCModule>();
             auto slc = sl->getContext();
@@ -317,6 +1080,67 @@ TEST_CASE( "ServiceLocator", "[servicelocator]" ) {
             REQUIRE(all[1]->getIt() == "TestB");
         }
 
+        SECTION("Resolve All runs after resolve functions once every binding is resolved") {
+            std::vector<std::string> log;
+            sl->bind<ITest>("A").to<TestA>([&log] (SLContext_sptr slc) {
+                log.push_back("A");
+                slc->afterResolve([&log] (SLContext_sptr) { log.push_back("after A"); });
+                return new TestA(slc);
+            });
+            sl->bind<ITest>("B").to<TestB>([&log] (SLContext_sptr slc) {
+                log.push_back("B");
+                slc->afterResolve([&log] (SLContext_sptr) { log.push_back("after B"); });
+                return new TestB(slc);
+            });
+            auto slc = sl->getContext();
+
+            slc->resolveAll<ITest>();
+            REQUIRE(log == std::vector<std::string>({ "A", "B", "after A", "after B" }));
+        }
+
+        SECTION("Resolve All singletons of a sealed locator is cached") {
+            sl->bind<ITest>("A").to<TestA>().asSingleton();
+            sl->bind<ITest>("B").to<TestB>().asSingleton();
+            auto child = sl->enter();
+            child->bind<ITest>("C").to<TestA>().asSingleton();
+            auto unsealed = child->getContext()->resolveAll<ITest>();
+            REQUIRE(unsealed->size() == 3);
+            REQUIRE(unsealed != child->getContext()->resolveAll<ITest>());
+
+            sl->seal();
+            child->seal();
+            auto slc = child->getContext();
+            auto all = slc->resolveAll<ITest>();
+            REQUIRE(all->size() == 3);
+            REQUIRE((*all)[0] == (*unsealed)[0]);
+            REQUIRE((*all)[1] == (*unsealed)[1]);
+            REQUIRE((*all)[2] == (*unsealed)[2]);
+            REQUIRE(all == slc->resolveAll<ITest>());
+
+            std::vector<std::shared_ptr<ITest>> appended(1);
+            slc->resolveAll<ITest>(&appended);
+            REQUIRE(appended.size() == 4);
+            REQUIRE(appended[3] == (*all)[2]);
+
+            // the cached vector outlives its ServiceLocator
+            child.reset();
+            slc.reset();
+            REQUIRE(std::count_if(all->begin(), all->end(), [] (std::shared_ptr<ITest> test) { return test->getIt() == "TestA"; }) == 2);
+        }
+
+        SECTION("Resolve All with a transient of a sealed locator is not cached") {
+            sl->bind<ITest>("A").to<TestA>().asSingleton();
+            sl->bind<ITest>("B").to<TestB>();
+            sl->seal();
+            auto slc = sl->getContext();
+
+            auto all = slc->resolveAll<ITest>();
+            auto again = slc->resolveAll<ITest>();
+            REQUIRE(all != again);
+            REQUIRE((*all)[0] == (*again)[0]);
+            REQUIRE((*all)[1] != (*again)[1]);
+        }
+
         SECTION("Eager binding") {
             sl->bind<TestEager>().toSelfNoDependancy().asSingleton().eagerly();
 
@@ -327,6 +1151,136 @@ TEST_CASE( "ServiceLocator", "[servicelocator]" ) {
 
             REQUIRE(TestEagerCount == 1);
         }
+
+        SECTION("Eager binding resolves under its bound name") {
+            std::string path;
+            sl->bind<TestNoSL>("eager").to<TestNoSL>([&path] (SLContext_sptr slc) {
+                path = slc->getResolvePath();
+                return new TestNoSL();
+            }).asSingleton().eagerly();
+
+            auto slc = sl->getContext();
+            REQUIRE(path == "resolve<TestNoSL>(eager).to<TestNoSL>");
+        }
+
+        SECTION("Parallel eager binding") {
+            TestSlowConstructCount = 0;
+            TestSlowConstructMaxActive = 0;
+            TestSlowConstructRendezvous = true;
+            for(int i = 0; i < 8; i++) {
+                sl->bind<TestSlowConstruct>("slow" + std::to_string(i)).toSelfNoDependancy().asSingleton().eagerly();
+            }
+            // depends on singletons other threads may be constructing
+            sl->bind<ITest>().to<TestA>([] (SLContext_sptr slc) {
+                slc->resolve<TestSlowConstruct>("slow0");
+                slc->resolve<TestSlowConstruct>("slow7");
+                return new TestA(slc);
+            }).asSingleton().eagerly();
+
+            auto report = sl->eagerInit(4);
+            TestSlowConstructRendezvous = false;
+
+            REQUIRE(TestSlowConstructCount == 8);
+            REQUIRE(report.bindings.size() == 9);
+            REQUIRE(report.bindings[0].interfaceType == "TestSlowConstruct");
+            REQUIRE(report.bindings[0].name == "slow0");
+            REQUIRE(report.bindings[8].interfaceType == "ITest");
+            // a constructor waits until another thread is constructing too, which a serial run never is
+            REQUIRE(TestSlowConstructMaxActive > 1);
+
+            // nothing left for getContext() to construct
+            sl->getContext()->resolve<ITest>();
+            REQUIRE(TestSlowConstructCount == 8);
+        }
+
+        SECTION("Parallel eager binding of singletons which depend on each other throws") {
+            sl->bind<ITest>("x").to<TestA>([] (SLContext_sptr slc) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                slc->resolve<ITest>("y");
+                return new TestA(slc);
+            }).asSingleton().eagerly();
+            sl->bind<ITest>("y").to<TestB>([] (SLContext_sptr slc) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                slc->resolve<ITest>("x");
+                return new TestB(slc);
+            }).asSingleton().eagerly();
+
+            REQUIRE_THROWS_AS(sl->eagerInit(2), RecursiveResolveException);
+
+            // the failed eager bindings are not run again
+            REQUIRE_NOTHROW(sl->getContext());
+        }
+
+        SECTION("Sealed locator rejects binding") {
+            sl->bind<ITest>().to<TestA>();
+            sl->seal();
+
+            REQUIRE(sl->isSealed());
+            REQUIRE_THROWS_AS((sl->bind<TestC>().toSelf()), BindingIssueException);
+            REQUIRE(sl->getContext()->resolve<ITest>()->getIt() == "TestA");
+
+            // children of a sealed locator can still bind
+            auto child = sl->enter();
+            child->bind<ITest>().to<TestB>();
+            REQUIRE(child->getContext()->resolve<ITest>()->getIt() == "TestB");
+        }
+
+        SECTION("Concurrent singleton resolve on sealed locator") {
+            TestSlowConstructCount = 0;
+            sl->bind<TestSlowConstruct>().toSelfNoDependancy().asSingleton();
+            sl->seal();
+            auto slc = sl->getContext();
+
+            std::vector<std::shared_ptr<TestSlowConstruct>> resolved(8);
+            std::vector<std::thread> threads;
+            for(size_t i = 0; i < resolved.size(); i++) {
+                threads.push_back(std::thread([&slc, &resolved, i] () {
+                    for(int n = 0; n < 100; n++) {
+                        resolved[i] = slc->resolve<TestSlowConstruct>();
+                    }
+                }));
+            }
+            for(auto& thread : threads) {
+                thread.join();
+            }
+
+            REQUIRE(TestSlowConstructCount == 1);
+            for(auto& r : resolved) {
+                REQUIRE(r == resolved[0]);
+            }
+        }
+
+#ifdef SERVICELOCATOR_STATS
+        SECTION("Binding statistics") {
+            sl->bind<ITest>("singleton").to<TestA>().asSingleton();
+            sl->bind<ITest>("transient").to<TestB>();
+            auto slc = sl->getContext();
+            for(int i = 0; i < 4; i++) {
+                slc->resolve<ITest>("singleton");
+                slc->resolve<ITest>("transient");
+            }
+
+            auto stats = sl->getBindingStats();
+            REQUIRE(stats.size() == 2);
+            for(auto& s : stats) {
+                REQUIRE(s.interfaceType == "ITest");
+                REQUIRE(s.resolves == 4);
+                REQUIRE(s.maxConstructionTime <= s.totalConstructionTime);
+                if (s.name == "singleton") {
+                    REQUIRE(s.constructions == 1);
+                    REQUIRE(s.cacheHits == 3);
+                    REQUIRE(s.cacheHitRate() == 0.75);
+                } else {
+                    REQUIRE(s.name == "transient");
+                    REQUIRE(s.constructions == 4);
+                    REQUIRE(s.cacheHits == 0);
+                }
+            }
+
+            std::stringstream dump;
+            sl->dumpBindingStats(dump);
+            REQUIRE(dump.str().find("bind<ITest>(singleton) resolves=4 constructions=1") != std::string::npos);
+        }
+#endif
     }
 }
-